@@ -0,0 +1,13 @@
+// Generated by tools/gen_command_hash.c from command_list.h
+#define COMMAND_HASH_SEED 263u
+#define COMMAND_HASH_SIZE 128
+#define COMMAND_HASH_SLOTS { \
+    33, -1, -1, -1, -1, -1, -1, 14, -1, -1, -1, -1, -1, -1, -1, 34, \
+    26, -1, -1, -1, -1, 31, -1, 2, -1, 13, -1, 9, -1, 47, 29, -1, \
+    -1, -1, -1, 16, -1, -1, 4, -1, -1, -1, -1, -1, -1, 20, -1, -1, \
+    10, -1, -1, 38, -1, -1, -1, -1, -1, -1, 18, 28, 49, 12, 48, -1, \
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, 30, 44, 36, 0, -1, -1, -1, \
+    -1, -1, -1, 46, 37, -1, -1, 3, 32, -1, -1, -1, -1, 24, -1, -1, \
+    -1, 11, -1, 40, -1, -1, -1, -1, -1, 22, -1, 6, -1, -1, -1, 42, \
+    -1, 5, -1, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 \
+}
@@ -0,0 +1,385 @@
+#include "bcache.h"
+#include "blockdev.h"
+#include "heap.h"
+#include "string.h"
+#include "timer.h"
+#include "types.h"
+
+#define BCACHE_NONE -1
+
+typedef struct {
+    uint32_t lba;
+    int hash_next;                 // Chain within an LBA bucket
+    int lru_prev;                  // Most recently used at the head
+    int lru_next;
+    uint8_t valid;
+    uint8_t dirty;
+} bcache_entry_t;
+
+static bcache_entry_t bcache_entries[BCACHE_SECTORS];
+static int bcache_buckets[BCACHE_HASH_SIZE];
+static int bcache_lru_head;
+static int bcache_lru_tail;
+
+static uint8_t* bcache_data;       // BCACHE_SECTORS sectors, one per entry
+static uint8_t* bcache_staging;    // Contiguous runs going to or from the drive
+static int bcache_ready = 0;
+static blockdev_t* bcache_device;
+
+static uint32_t bcache_sequential; // LBA that would continue the last access
+static uint32_t bcache_last_write; // Tick of the oldest unflushed write
+static bcache_stats_t bcache_stats;
+
+static uint8_t* bcache_sector(int index) {
+    return bcache_data + index * BLOCKDEV_SECTOR_SIZE;
+}
+
+static int bcache_bucket(uint32_t lba) {
+    return (lba * 2654435761u) >> 22 & (BCACHE_HASH_SIZE - 1);
+}
+
+static int bcache_lookup(uint32_t lba) {
+    for (int i = bcache_buckets[bcache_bucket(lba)]; i != BCACHE_NONE; i = bcache_entries[i].hash_next) {
+        if (bcache_entries[i].lba == lba) {
+            return i;
+        }
+    }
+    return BCACHE_NONE;
+}
+
+static void bcache_unhash(int index) {
+    int* link = &bcache_buckets[bcache_bucket(bcache_entries[index].lba)];
+    while (*link != index) {
+        link = &bcache_entries[*link].hash_next;
+    }
+    *link = bcache_entries[index].hash_next;
+}
+
+static void bcache_lru_remove(int index) {
+    bcache_entry_t* entry = &bcache_entries[index];
+    
+    if (entry->lru_prev != BCACHE_NONE) {
+        bcache_entries[entry->lru_prev].lru_next = entry->lru_next;
+    } else {
+        bcache_lru_head = entry->lru_next;
+    }
+    if (entry->lru_next != BCACHE_NONE) {
+        bcache_entries[entry->lru_next].lru_prev = entry->lru_prev;
+    } else {
+        bcache_lru_tail = entry->lru_prev;
+    }
+}
+
+static void bcache_lru_push(int index) {
+    bcache_entry_t* entry = &bcache_entries[index];
+    
+    entry->lru_prev = BCACHE_NONE;
+    entry->lru_next = bcache_lru_head;
+    if (bcache_lru_head != BCACHE_NONE) {
+        bcache_entries[bcache_lru_head].lru_prev = index;
+    } else {
+        bcache_lru_tail = index;
+    }
+    bcache_lru_head = index;
+}
+
+static void bcache_touch(int index) {
+    if (bcache_lru_head != index) {
+        bcache_lru_remove(index);
+        bcache_lru_push(index);
+    }
+}
+
+static void bcache_reset(void) {
+    for (int i = 0; i < BCACHE_HASH_SIZE; i++) {
+        bcache_buckets[i] = BCACHE_NONE;
+    }
+    
+    bcache_lru_head = BCACHE_NONE;
+    bcache_lru_tail = BCACHE_NONE;
+    for (int i = 0; i < BCACHE_SECTORS; i++) {
+        bcache_entries[i].valid = 0;
+        bcache_entries[i].dirty = 0;
+        bcache_entries[i].hash_next = BCACHE_NONE;
+        bcache_lru_push(i);
+    }
+    
+    bcache_sequential = 0;
+    bcache_stats.dirty = 0;
+}
+
+int bcache_init(blockdev_t* device) {
+    if (!device) {
+        return 0;
+    }
+    
+    if (!bcache_data) {
+        bcache_data = kmalloc(BCACHE_SECTORS * BLOCKDEV_SECTOR_SIZE);
+        bcache_staging = kmalloc(BCACHE_READAHEAD * BLOCKDEV_SECTOR_SIZE);
+        if (!bcache_data || !bcache_staging) {
+            kfree(bcache_data);
+            kfree(bcache_staging);
+            bcache_data = NULL;
+            bcache_staging = NULL;
+            return 0;
+        }
+    }
+    
+    bcache_reset();
+    bcache_reset_stats();
+    bcache_device = device;
+    bcache_ready = 1;
+    return 1;
+}
+
+blockdev_t* bcache_get_device(void) {
+    return bcache_ready ? bcache_device : NULL;
+}
+
+// A run that fails to write stays dirty, so the next flush retries it
+static int bcache_write_run(uint32_t lba, int* run, int length) {
+    for (int i = 0; i < length; i++) {
+        memcpy(bcache_staging + i * BLOCKDEV_SECTOR_SIZE, bcache_sector(run[i]), BLOCKDEV_SECTOR_SIZE);
+    }
+    
+    bcache_stats.device_writes++;
+    if (!bcache_device->write(lba, length, bcache_staging)) {
+        return 0;
+    }
+    
+    for (int i = 0; i < length; i++) {
+        bcache_entries[run[i]].dirty = 0;
+    }
+    bcache_stats.sectors_written += length;
+    bcache_stats.dirty -= length;
+    return 1;
+}
+
+// Write every dirty sector back, sorted by LBA so neighbours go out as one
+// multi-sector command
+int bcache_flush(void) {
+    if (!bcache_ready || bcache_stats.dirty == 0) {
+        return 1;
+    }
+    
+    int dirty[BCACHE_SECTORS];
+    int count = 0;
+    
+    for (int i = 0; i < BCACHE_SECTORS; i++) {
+        if (bcache_entries[i].dirty) {
+            uint32_t lba = bcache_entries[i].lba;
+            int j = count++;
+            while (j > 0 && bcache_entries[dirty[j - 1]].lba > lba) {
+                dirty[j] = dirty[j - 1];
+                j--;
+            }
+            dirty[j] = i;
+        }
+    }
+    
+    int ok = 1;
+    int start = 0;
+    for (int i = 1; i <= count; i++) {
+        int length = i - start;
+        int contiguous = i < count && bcache_entries[dirty[i]].lba == bcache_entries[dirty[i - 1]].lba + 1;
+        
+        if (!contiguous || length == BCACHE_READAHEAD) {
+            ok &= bcache_write_run(bcache_entries[dirty[start]].lba, &dirty[start], length);
+            start = i;
+        }
+    }
+    
+    return bcache_device->flush() && ok;
+}
+
+// Called from the shell's idle loop: write back once the oldest dirty
+// sector has waited BCACHE_FLUSH_TICKS
+void bcache_idle(void) {
+    if (bcache_ready && bcache_stats.dirty > 0 && timer_ticks() - bcache_last_write >= BCACHE_FLUSH_TICKS) {
+        bcache_flush();
+    }
+}
+
+// Write back and forget everything, so the next access goes to the drive.
+// Nothing is forgotten if some dirty sector can't be written.
+int bcache_invalidate(void) {
+    if (!bcache_ready || !bcache_flush()) {
+        return 0;
+    }
+    
+    bcache_reset();
+    return 1;
+}
+
+// Take the least recently used entry and move it to the head, unhashed and
+// invalid. A dirty victim is written back along with every other dirty
+// sector, which keeps write-back in large runs. If that fails, the least
+// recently used clean entry is taken instead, or BCACHE_NONE if every
+// entry holds unwritten data.
+static int bcache_claim(void) {
+    int index = bcache_lru_tail;
+    
+    if (bcache_entries[index].dirty && !bcache_flush()) {
+        while (index != BCACHE_NONE && bcache_entries[index].dirty) {
+            index = bcache_entries[index].lru_prev;
+        }
+        if (index == BCACHE_NONE) {
+            return BCACHE_NONE;
+        }
+    }
+    
+    bcache_entry_t* entry = &bcache_entries[index];
+    if (entry->valid) {
+        bcache_unhash(index);
+        entry->valid = 0;
+    }
+    
+    bcache_touch(index);
+    return index;
+}
+
+static void bcache_insert(int index, uint32_t lba) {
+    bcache_entry_t* entry = &bcache_entries[index];
+    int bucket = bcache_bucket(lba);
+    
+    entry->lba = lba;
+    entry->valid = 1;
+    entry->hash_next = bcache_buckets[bucket];
+    bcache_buckets[bucket] = index;
+}
+
+// Bring in the sector at `lba` after a miss, along with the rest of the
+// request and, if the access pattern is sequential, a read-ahead window.
+// The window stops at the first sector already cached so dirty data is
+// never overwritten.
+static int bcache_fill(uint32_t lba, unsigned int wanted) {
+    unsigned int window = wanted;
+    if (lba == bcache_sequential && window < BCACHE_READAHEAD) {
+        window = BCACHE_READAHEAD;
+    }
+    if (window > BCACHE_READAHEAD) {
+        window = BCACHE_READAHEAD;
+    }
+    if (window > bcache_device->sectors - lba) {
+        window = bcache_device->sectors - lba;
+    }
+    for (unsigned int i = 1; i < window; i++) {
+        if (bcache_lookup(lba + i) != BCACHE_NONE) {
+            window = i;
+            break;
+        }
+    }
+    
+    // Claim first: write-back of a victim goes through the staging buffer.
+    // If write-back fails the window shrinks to the clean entries left,
+    // never handing out one already claimed in this loop.
+    int claimed[BCACHE_READAHEAD];
+    for (unsigned int i = 0; i < window; i++) {
+        claimed[i] = bcache_claim();
+        for (unsigned int j = 0; j < i && claimed[i] != BCACHE_NONE; j++) {
+            if (claimed[j] == claimed[i]) {
+                claimed[i] = BCACHE_NONE;
+            }
+        }
+        if (claimed[i] == BCACHE_NONE) {
+            window = i;
+            break;
+        }
+    }
+    if (window == 0) {
+        return BCACHE_NONE;
+    }
+    
+    bcache_stats.device_reads++;
+    bcache_stats.sectors_read += window;
+    if (window > wanted) {
+        bcache_stats.readahead += window - wanted;
+    }
+    
+    if (!bcache_device->read(lba, window, bcache_staging)) {
+        return BCACHE_NONE;
+    }
+    
+    for (unsigned int i = 0; i < window; i++) {
+        memcpy(bcache_sector(claimed[i]), bcache_staging + i * BLOCKDEV_SECTOR_SIZE, BLOCKDEV_SECTOR_SIZE);
+        bcache_insert(claimed[i], lba + i);
+    }
+    
+    bcache_touch(claimed[0]);
+    return claimed[0];
+}
+
+int bcache_read(uint32_t lba, unsigned int count, void* buffer) {
+    if (!bcache_ready || lba >= bcache_device->sectors || count > bcache_device->sectors - lba) {
+        return 0;
+    }
+    
+    uint8_t* data = buffer;
+    for (unsigned int i = 0; i < count; i++, lba++) {
+        int index = bcache_lookup(lba);
+        
+        if (index != BCACHE_NONE) {
+            bcache_stats.hits++;
+            bcache_touch(index);
+        } else {
+            bcache_stats.misses++;
+            index = bcache_fill(lba, count - i);
+            if (index == BCACHE_NONE) {
+                return 0;
+            }
+        }
+        
+        memcpy(data, bcache_sector(index), BLOCKDEV_SECTOR_SIZE);
+        data += BLOCKDEV_SECTOR_SIZE;
+        bcache_sequential = lba + 1;
+    }
+    return 1;
+}
+
+// Writes only touch the cache; whole sectors are overwritten, so a miss
+// needs no read from the drive
+int bcache_write(uint32_t lba, unsigned int count, const void* buffer) {
+    if (!bcache_ready || lba >= bcache_device->sectors || count > bcache_device->sectors - lba) {
+        return 0;
+    }
+    
+    const uint8_t* data = buffer;
+    for (unsigned int i = 0; i < count; i++, lba++) {
+        int index = bcache_lookup(lba);
+        
+        if (index != BCACHE_NONE) {
+            bcache_stats.hits++;
+            bcache_touch(index);
+        } else {
+            bcache_stats.misses++;
+            index = bcache_claim();
+            if (index == BCACHE_NONE) {
+                return 0;
+            }
+            bcache_insert(index, lba);
+        }
+        
+        memcpy(bcache_sector(index), data, BLOCKDEV_SECTOR_SIZE);
+        data += BLOCKDEV_SECTOR_SIZE;
+        
+        if (!bcache_entries[index].dirty) {
+            if (bcache_stats.dirty == 0) {
+                bcache_last_write = timer_ticks();
+            }
+            bcache_entries[index].dirty = 1;
+            bcache_stats.dirty++;
+        }
+    }
+    return 1;
+}
+
+void bcache_get_stats(bcache_stats_t* stats) {
+    *stats = bcache_stats;
+}
+
+// Clear the counters; the dirty count describes the cache, not history
+void bcache_reset_stats(void) {
+    unsigned int dirty = bcache_stats.dirty;
+    memset(&bcache_stats, 0, sizeof(bcache_stats));
+    bcache_stats.dirty = dirty;
+}
@@ -12,6 +12,10 @@ section .text
 start:
     mov esp, stack_top
 
+    ; Pass the multiboot magic (EAX) and info pointer (EBX) to the kernel
+    push ebx
+    push eax
+
     ; Call kernel
     call kernel_main
 
@@ -0,0 +1,67 @@
+#include "cpu.h"
+#include "string.h"
+#include "types.h"
+
+static uint32_t cpu_features = 0;
+
+// CPUID exists if the ID bit in EFLAGS can be flipped
+static int cpu_has_cpuid(void) {
+    uint32_t before;
+    uint32_t after;
+    
+    __asm__ volatile(
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "movl %0, %1\n\t"
+        "xorl $0x200000, %1\n\t"
+        "pushl %1\n\t"
+        "popfl\n\t"
+        "pushfl\n\t"
+        "popl %1\n\t"
+        "pushl %0\n\t"
+        "popfl"
+        : "=&r" (before), "=&r" (after));
+    
+    return ((before ^ after) & 0x200000) != 0;
+}
+
+static void cpu_enable_sse(void) {
+    uint32_t cr0;
+    uint32_t cr4;
+    
+    __asm__ volatile("mov %%cr0, %0" : "=r" (cr0));
+    cr0 &= ~CPU_CR0_EM;
+    cr0 |= CPU_CR0_MP;
+    __asm__ volatile("mov %0, %%cr0" : : "r" (cr0));
+    
+    __asm__ volatile("mov %%cr4, %0" : "=r" (cr4));
+    cr4 |= CPU_CR4_OSFXSR | CPU_CR4_OSXMMEXCPT;
+    __asm__ volatile("mov %0, %%cr4" : : "r" (cr4));
+    
+    __asm__ volatile("fninit");
+}
+
+// Detect CPU features and turn on SSE so the string routines can use SSE2.
+// Interrupt handlers never touch XMM registers, so no state needs saving.
+void cpu_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    if (!cpu_has_cpuid()) {
+        return;
+    }
+    
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    cpu_features = edx;
+    
+    if (cpu_has_feature(CPU_FEATURE_SSE)) {
+        cpu_enable_sse();
+        
+        if (cpu_has_feature(CPU_FEATURE_SSE2)) {
+            string_set_sse2(1);
+        }
+    }
+}
+
+int cpu_has_feature(uint32_t feature) {
+    return (cpu_features & feature) != 0;
+}
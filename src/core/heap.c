@@ -0,0 +1,261 @@
+#include "heap.h"
+#include "pmm.h"
+#include "types.h"
+
+#define KHEAP_SLAB_MAGIC 0x51AB0000
+#define KHEAP_LARGE_MAGIC 0x1A760000
+
+// Every heap page starts with a header, so kfree() can find it by masking
+// the pointer down to its page.
+typedef struct slab {
+    uint32_t magic;
+    struct slab* next;         // Partial-slab list for this class
+    struct slab* prev;
+    void* free_list;           // Free objects, each holding the next pointer
+    uint16_t class_index;
+    uint16_t in_use;
+    uint16_t capacity;
+    uint16_t on_list;
+} slab_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t pages;
+    uint32_t reserved[2];
+} large_header_t;
+
+#define KHEAP_SLAB_HEADER ((sizeof(slab_t) + 15) & ~15)
+
+typedef struct {
+    slab_t* partial;           // Slabs with at least one free object
+    slab_t* empty;             // One fully free slab kept to avoid page churn
+    kheap_class_stats_t stats;
+} kheap_class_t;
+
+static kheap_class_t kheap_classes[KHEAP_CLASS_COUNT];
+static kheap_page_stats_t kheap_pages;
+
+// Heap pages come straight from the physical memory manager
+void* page_alloc(unsigned int count) {
+    void* page = pmm_alloc_pages(count);
+    if (!page) {
+        return NULL;
+    }
+
+    kheap_pages.used_pages += count;
+    if (kheap_pages.used_pages > kheap_pages.peak_pages) {
+        kheap_pages.peak_pages = kheap_pages.used_pages;
+    }
+    return page;
+}
+
+void page_free(void* page, unsigned int count) {
+    pmm_free_pages(page, count);
+    kheap_pages.used_pages -= count;
+}
+
+void kheap_init(void) {
+    for (int i = 0; i < KHEAP_CLASS_COUNT; i++) {
+        kheap_classes[i].partial = NULL;
+        kheap_classes[i].empty = NULL;
+        kheap_classes[i].stats.object_size = 1u << (KHEAP_MIN_CLASS_SHIFT + i);
+        kheap_classes[i].stats.in_use = 0;
+        kheap_classes[i].stats.peak = 0;
+        kheap_classes[i].stats.slabs = 0;
+        kheap_classes[i].stats.capacity = 0;
+    }
+
+    kheap_pages.total_pages = 0;
+    kheap_pages.free_pages = 0;
+    kheap_pages.used_pages = 0;
+    kheap_pages.peak_pages = 0;
+    kheap_pages.large_allocations = 0;
+}
+
+static int kheap_class_for(size_t size) {
+    int index = 0;
+    size_t class_size = 1u << KHEAP_MIN_CLASS_SHIFT;
+
+    while (class_size < size) {
+        class_size <<= 1;
+        index++;
+    }
+
+    return index;
+}
+
+static void slab_list_push(slab_t** head, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head) {
+        (*head)->prev = slab;
+    }
+    *head = slab;
+    slab->on_list = 1;
+}
+
+static void slab_list_remove(slab_t** head, slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *head = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = NULL;
+    slab->prev = NULL;
+    slab->on_list = 0;
+}
+
+// Carve a fresh page into equal objects threaded onto its free list
+static slab_t* slab_create(int class_index) {
+    slab_t* slab = page_alloc(1);
+    if (!slab) {
+        return NULL;
+    }
+
+    unsigned int object_size = kheap_classes[class_index].stats.object_size;
+
+    slab->magic = KHEAP_SLAB_MAGIC;
+    slab->class_index = class_index;
+    slab->in_use = 0;
+    slab->capacity = (PAGE_SIZE - KHEAP_SLAB_HEADER) / object_size;
+    slab->free_list = NULL;
+    slab->next = NULL;
+    slab->prev = NULL;
+    slab->on_list = 0;
+
+    uint8_t* objects = (uint8_t*)slab + KHEAP_SLAB_HEADER;
+    for (int i = slab->capacity - 1; i >= 0; i--) {
+        void** object = (void**)(objects + i * object_size);
+        *object = slab->free_list;
+        slab->free_list = object;
+    }
+
+    kheap_classes[class_index].stats.slabs++;
+    kheap_classes[class_index].stats.capacity += slab->capacity;
+    return slab;
+}
+
+static void* kmalloc_small(size_t size) {
+    int class_index = kheap_class_for(size);
+    kheap_class_t* cache = &kheap_classes[class_index];
+    slab_t* slab = cache->partial;
+
+    if (!slab) {
+        if (cache->empty) {
+            slab = cache->empty;
+            cache->empty = NULL;
+        } else {
+            slab = slab_create(class_index);
+            if (!slab) {
+                return NULL;
+            }
+        }
+        slab_list_push(&cache->partial, slab);
+    }
+
+    void** object = slab->free_list;
+    slab->free_list = *object;
+    slab->in_use++;
+
+    // Full slabs leave the partial list until something is freed
+    if (!slab->free_list) {
+        slab_list_remove(&cache->partial, slab);
+    }
+
+    cache->stats.in_use++;
+    if (cache->stats.in_use > cache->stats.peak) {
+        cache->stats.peak = cache->stats.in_use;
+    }
+
+    return object;
+}
+
+static void kfree_small(slab_t* slab, void* ptr) {
+    kheap_class_t* cache = &kheap_classes[slab->class_index];
+
+    *(void**)ptr = slab->free_list;
+    slab->free_list = ptr;
+    slab->in_use--;
+    cache->stats.in_use--;
+
+    if (!slab->on_list) {
+        slab_list_push(&cache->partial, slab);
+    }
+
+    if (slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+
+        // Keep one empty slab around, return the rest to the page allocator
+        if (!cache->empty) {
+            cache->empty = slab;
+        } else {
+            cache->stats.slabs--;
+            cache->stats.capacity -= slab->capacity;
+            slab->magic = 0;
+            page_free(slab, 1);
+        }
+    }
+}
+
+void* kmalloc(size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    if (size <= KHEAP_MAX_SLAB_OBJECT) {
+        return kmalloc_small(size);
+    }
+
+    unsigned int pages = (size + sizeof(large_header_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+    large_header_t* header = page_alloc(pages);
+    if (!header) {
+        return NULL;
+    }
+
+    header->magic = KHEAP_LARGE_MAGIC;
+    header->pages = pages;
+    kheap_pages.large_allocations++;
+
+    return header + 1;
+}
+
+void* kzalloc(size_t size) {
+    uint8_t* ptr = kmalloc(size);
+    if (ptr) {
+        for (size_t i = 0; i < size; i++) {
+            ptr[i] = 0;
+        }
+    }
+    return ptr;
+}
+
+void kfree(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    uint32_t* page = (uint32_t*)((uint32_t)ptr & ~(PAGE_SIZE - 1));
+
+    if (*page == KHEAP_SLAB_MAGIC) {
+        kfree_small((slab_t*)page, ptr);
+    } else if (*page == KHEAP_LARGE_MAGIC) {
+        large_header_t* header = (large_header_t*)page;
+        header->magic = 0;
+        kheap_pages.large_allocations--;
+        page_free(header, header->pages);
+    }
+}
+
+void kheap_get_class_stats(int index, kheap_class_stats_t* stats) {
+    *stats = kheap_classes[index].stats;
+}
+
+void kheap_get_page_stats(kheap_page_stats_t* stats) {
+    kheap_pages.total_pages = pmm_total_pages();
+    kheap_pages.free_pages = pmm_free_page_count();
+    kheap_pages.largest_free_run = pmm_largest_free_run();
+    *stats = kheap_pages;
+}
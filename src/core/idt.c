@@ -0,0 +1,126 @@
+#include "idt.h"
+#include "io.h"
+#include "types.h"
+
+// Assembly stubs from interrupts.asm
+extern void idt_load(idt_pointer_t* pointer);
+extern void irq0(void);
+extern void irq1(void);
+extern void irq2(void);
+extern void irq3(void);
+extern void irq4(void);
+extern void irq5(void);
+extern void irq6(void);
+extern void irq7(void);
+extern void irq8(void);
+extern void irq9(void);
+extern void irq10(void);
+extern void irq11(void);
+extern void irq12(void);
+extern void irq13(void);
+extern void irq14(void);
+extern void irq15(void);
+
+static idt_entry_t idt[IDT_ENTRIES];
+static idt_pointer_t idt_pointer;
+static irq_handler_t irq_handlers[IRQ_COUNT];
+
+static void (*const irq_stubs[IRQ_COUNT])(void) = {
+    irq0, irq1, irq2, irq3, irq4, irq5, irq6, irq7,
+    irq8, irq9, irq10, irq11, irq12, irq13, irq14, irq15
+};
+
+// Small delay for the PIC to settle between initialization words
+static inline void io_wait(void) {
+    outb(0x80, 0);
+}
+
+static void idt_set_gate(int vector, uint32_t handler, uint16_t selector) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = selector;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = IDT_GATE_INTERRUPT;
+    idt[vector].offset_high = (handler >> 16) & 0xFFFF;
+}
+
+// Move IRQ 0-15 to vectors 0x20-0x2F so they don't collide with CPU exceptions
+static void pic_remap(void) {
+    outb(PIC1_COMMAND, 0x11);  // ICW1: initialize, expect ICW4
+    io_wait();
+    outb(PIC2_COMMAND, 0x11);
+    io_wait();
+    outb(PIC1_DATA, IRQ_BASE_VECTOR);  // ICW2: vector offsets
+    io_wait();
+    outb(PIC2_DATA, IRQ_BASE_VECTOR + 8);
+    io_wait();
+    outb(PIC1_DATA, 0x04);  // ICW3: slave on IRQ2
+    io_wait();
+    outb(PIC2_DATA, 0x02);
+    io_wait();
+    outb(PIC1_DATA, 0x01);  // ICW4: 8086 mode
+    io_wait();
+    outb(PIC2_DATA, 0x01);
+    io_wait();
+
+    // Mask everything except the cascade line until a handler is installed
+    outb(PIC1_DATA, (unsigned char)~(1 << IRQ_CASCADE));
+    outb(PIC2_DATA, 0xFF);
+}
+
+static void pic_unmask(int irq) {
+    unsigned short port = PIC1_DATA;
+
+    if (irq >= 8) {
+        port = PIC2_DATA;
+        irq -= 8;
+    }
+
+    outb(port, inb(port) & ~(1 << irq));
+}
+
+void idt_init(void) {
+    // Use whatever code segment the bootloader left us in
+    uint16_t code_selector;
+    __asm__ volatile("mov %%cs, %0" : "=r" (code_selector));
+
+    for (int i = 0; i < IDT_ENTRIES; i++) {
+        idt[i].offset_low = 0;
+        idt[i].selector = 0;
+        idt[i].zero = 0;
+        idt[i].type_attr = 0;
+        idt[i].offset_high = 0;
+    }
+
+    for (int i = 0; i < IRQ_COUNT; i++) {
+        irq_handlers[i] = NULL;
+        idt_set_gate(IRQ_BASE_VECTOR + i, (uint32_t)irq_stubs[i], code_selector);
+    }
+
+    idt_pointer.limit = sizeof(idt) - 1;
+    idt_pointer.base = (uint32_t)&idt;
+    idt_load(&idt_pointer);
+
+    pic_remap();
+}
+
+void irq_install_handler(int irq, irq_handler_t handler) {
+    if (irq < 0 || irq >= IRQ_COUNT) {
+        return;
+    }
+
+    irq_handlers[irq] = handler;
+    pic_unmask(irq);
+}
+
+// Called from the assembly stubs with interrupts disabled
+void irq_dispatch(int irq) {
+    if (irq_handlers[irq]) {
+        irq_handlers[irq]();
+    }
+
+    // Acknowledge the interrupt, slave first for IRQ 8-15
+    if (irq >= 8) {
+        outb(PIC2_COMMAND, PIC_EOI);
+    }
+    outb(PIC1_COMMAND, PIC_EOI);
+}
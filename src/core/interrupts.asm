@@ -0,0 +1,48 @@
+bits 32
+global idt_load
+extern irq_dispatch
+
+; Stub for hardware IRQ %1: push the IRQ number and jump to the common handler
+%macro IRQ_STUB 1
+global irq%1
+irq%1:
+    push dword %1
+    jmp irq_common
+%endmacro
+
+section .text
+IRQ_STUB 0
+IRQ_STUB 1
+IRQ_STUB 2
+IRQ_STUB 3
+IRQ_STUB 4
+IRQ_STUB 5
+IRQ_STUB 6
+IRQ_STUB 7
+IRQ_STUB 8
+IRQ_STUB 9
+IRQ_STUB 10
+IRQ_STUB 11
+IRQ_STUB 12
+IRQ_STUB 13
+IRQ_STUB 14
+IRQ_STUB 15
+
+irq_common:
+    pusha
+    cld
+
+    ; IRQ number sits just above the eight saved registers
+    push dword [esp + 32]
+    call irq_dispatch
+    add esp, 4
+
+    popa
+    add esp, 4
+    iret
+
+; void idt_load(idt_pointer_t* pointer)
+idt_load:
+    mov eax, [esp + 4]
+    lidt [eax]
+    ret
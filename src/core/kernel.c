@@ -1,4 +1,5 @@
 #include "vga.h"
+#include "idt.h"
 #include "commands.h"
 #include "string.h"
 #include "keyboard.h"
@@ -6,22 +7,32 @@
 #include "filesystem.h"
 #include "types.h"
 #include "constants.h"
+#include "heap.h"
+#include "pmm.h"
+#include "timer.h"
+#include "cpu.h"
+#include "registry.h"
+#include "history.h"
+#include "pci.h"
+#include "ata.h"
+#include "virtio_blk.h"
+#include "bcache.h"
+#include "fat.h"
+#include "initrd.h"
+#include "snapshot.h"
+#include "multiboot.h"
 
 char input_buffer[MAX_COMMAND_LENGTH];
 int buffer_position = 0;
 
-char command_history[COMMAND_HISTORY_SIZE][MAX_COMMAND_LENGTH];
-int history_count = 0;
 int history_position = -1;
 
-void kernel_main();
+void kernel_main(uint32_t magic, multiboot_info_t* mbi);
 void process_command();
-void parse_args(char* input, char* command, char* arg1, char* arg2);
-void add_to_history(const char* command);
 void navigate_history(int direction);
 void handle_tab_completion();
 
-void kernel_main() {
+void kernel_main(uint32_t magic, multiboot_info_t* mbi) {
     // Direct VGA buffer access for initial screen setup
     volatile unsigned short* vga_buffer = (volatile unsigned short*)0xB8000;
     
@@ -30,10 +41,36 @@ void kernel_main() {
         vga_buffer[i] = 0x0720;
     }
     
-    // Init display, keyboard and filesystem drivers.
+    // Init CPU features, display, interrupts, keyboard, timer, memory and
+    // filesystem drivers.
+    cpu_init();
     vga_init();
+    idt_init();
     keyboard_init();
-    fs_init();
+    timer_init();
+    pmm_init(magic, mbi);
+    kheap_init();
+    
+    // The RAM filesystem gets a quarter of free memory
+    fs_init(pmm_free_page_count() / 4 * PAGE_SIZE);
+    
+    // Files packed into the initrd module, read where GRUB left them
+    initrd_init(magic, mbi);
+    
+    // A virtio disk if QEMU has one, else the primary IDE disk. A snapshot
+    // saved at its end replaces the default files, and its FAT volume (if
+    // it has one) goes under \DISK.
+    pci_init();
+    blockdev_t* disk = NULL;
+    if (virtio_blk_init()) {
+        disk = &virtio_blk_device;
+    } else if (ata_init()) {
+        disk = &ata_device;
+    }
+    if (disk && bcache_init(disk)) {
+        snapshot_load();
+        fat_mount("\\DISK");
+    }
     
     // Print welcome message
     vga_println("");
@@ -57,44 +94,56 @@ void kernel_main() {
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     vga_println(".");
     
-    // Initialize command history
-    for (int i = 0; i < COMMAND_HISTORY_SIZE; i++) {
-        command_history[i][0] = '\0';
-    }
+    history_init();
     
     // Show prompt with current directory
     vga_print(PROMPT_PREFIX);
     vga_print(fs_current_dir);
     vga_print(">");
 
-    // Main loop
+    interrupts_enable();
+
+    // Main loop: drain queued keystrokes, then sleep until the next IRQ
     while (1) {
         keyboard_handler();
+        
+        // Anything echoed by vga_putchar reaches the screen before we sleep
+        vga_flush();
+        
+        // Write back dirty disk sectors that have waited long enough
+        bcache_idle();
+        
+        // Check and halt with interrupts off so a keystroke can't slip in between
+        interrupts_disable();
+        if (keyboard_is_key_available()) {
+            interrupts_enable();
+        } else {
+            interrupts_wait();
+        }
     }
 }
 
-void add_to_history(const char* command) {
-    // Don't add empty commands or duplicates of the last command
-    if (strlen(command) == 0 || (history_count > 0 && strcmp(command, command_history[history_count - 1]) == 0)) {
-        return;
+// Redraw the prompt and the line being edited from the start of the row
+static void redraw_input_line(void) {
+    vga_cursor_x = 0;
+    for (int i = 0; i < VGA_WIDTH - 1; i++) {
+        vga_putchar(' ');
     }
+    vga_cursor_x = 0;
     
-    // Shift history if it's full
-    if (history_count == COMMAND_HISTORY_SIZE) {
-        for (int i = 0; i < COMMAND_HISTORY_SIZE - 1; i++) {
-            strcpy(command_history[i], command_history[i + 1]);
-        }
-        history_count--;
-    }
-    
-    // Add the new command
-    strcpy(command_history[history_count], command);
-    history_count++;
+    vga_print(PROMPT_PREFIX);
+    vga_print(fs_current_dir);
+    vga_print(">");
+    vga_print(input_buffer);
 }
 
+// A positive direction steps to older commands, negative to newer ones.
+// Position -1 is the fresh line below the newest entry.
 void navigate_history(int direction) {
+    int count = history_length();
+    
     // No history to navigate
-    if (history_count == 0) {
+    if (count == 0) {
         return;
     }
     
@@ -104,8 +153,8 @@ void navigate_history(int direction) {
     // Bounds checking
     if (new_position < -1) {
         new_position = -1;
-    } else if (new_position >= history_count) {
-        new_position = history_count - 1;
+    } else if (new_position >= count) {
+        new_position = count - 1;
     }
     
     // No change needed
@@ -125,7 +174,7 @@ void navigate_history(int direction) {
         input_buffer[0] = '\0';
     } else {
         // Copy from history to input buffer
-        strcpy(input_buffer, command_history[history_position]);
+        strcpy(input_buffer, history_entry(history_position));
         buffer_position = strlen(input_buffer);
         
         // Display the command
@@ -133,294 +182,326 @@ void navigate_history(int direction) {
     }
 }
 
-// Handle tab completion for filenames
-void handle_tab_completion() {
-    // Make sure we have something to complete
-    if (buffer_position == 0) {
-        return;
+// Ctrl-R reverse incremental search. Each typed character narrows the
+// pattern and the search moves to older matches only; another Ctrl-R skips
+// to the next older match.
+static int search_active = 0;
+static int search_failed;
+static int search_age;             // Entry shown, -1 before anything matched
+static int search_length;
+static char search_pattern[MAX_COMMAND_LENGTH];
+static char search_saved[MAX_COMMAND_LENGTH];
+
+static void reverse_search_draw(void) {
+    char line[VGA_WIDTH];
+    const char* match = search_age >= 0 ? history_entry(search_age) : "";
+    
+    strcpy(line, search_failed ? "(failed reverse-i-search)`" : "(reverse-i-search)`");
+    
+    // Keep the whole thing on one row
+    int length = strlen(line);
+    for (const char* part = search_pattern; *part && length < VGA_WIDTH - 1; part++) {
+        line[length++] = *part;
+    }
+    for (const char* part = "': "; *part && length < VGA_WIDTH - 1; part++) {
+        line[length++] = *part;
+    }
+    for (const char* part = match; *part && length < VGA_WIDTH - 1; part++) {
+        line[length++] = *part;
     }
+    line[length] = '\0';
     
-    // Save current input with null termination for string operations
-    input_buffer[buffer_position] = '\0';
+    vga_cursor_x = 0;
+    for (int i = 0; i < VGA_WIDTH - 1; i++) {
+        vga_putchar(' ');
+    }
+    vga_cursor_x = 0;
+    vga_print(line);
+}
+
+static void reverse_search_step(int from) {
+    int age = history_find(search_pattern, from);
     
-    // Parse to get command and first argument
-    char command[32];
-    char partial_arg[64];
-    char dummy[64];
-    parse_args(input_buffer, command, partial_arg, dummy);
-    
-    // Only try to complete if we have a partial argument
-    if (partial_arg[0] != '\0') {
-        // Convert command to lowercase for comparison
-        for (int i = 0; command[i]; i++) {
-            if (command[i] >= 'A' && command[i] <= 'Z') {
-                command[i] = command[i] + 32;
-            }
-        }
-        
-        // Prepare full path for completion if needed
-        char full_path[FS_MAX_FILENAME];
-        full_path[0] = '\0';
-        
-        // If it's a relative path (doesn't start with '\')
-        if (partial_arg[0] != '\\') {
-            // Construct full path from current directory
-            if (strcmp(fs_current_dir, "\\") == 0) {
-                strcpy(full_path, "\\");
-                strcat(full_path, partial_arg);
-            } else {
-                strcpy(full_path, fs_current_dir);
-                strcat(full_path, "\\");
-                strcat(full_path, partial_arg);
-            }
-        } else {
-            // Already an absolute path
-            strcpy(full_path, partial_arg);
-        }
-        
-        // Try to find matching files/directories
-        char* best_match = NULL;
-        int match_count = 0;
-        
-        for (int i = 0; i < fs_file_count; i++) {
-            int type_match = 1;
-            
-            // Filter by type for certain commands
-            if (strcmp(command, "type") == 0 || strcmp(command, "cat") == 0 ||
-                strcmp(command, "del") == 0 || strcmp(command, "delete") == 0) {
-                type_match = (fs_files[i].type == FS_FILE);
-            } else if (strcmp(command, "cd") == 0 || strcmp(command, "chdir") == 0 ||
-                        strcmp(command, "mkdir") == 0 || strcmp(command, "md") == 0) {
-                type_match = (fs_files[i].type == FS_DIRECTORY);
-            }
-            
-            if (!type_match) continue;
-            
-            // Check if this file/dir path starts with our partial path
-            if (strncmp(fs_files[i].name, full_path, strlen(full_path)) == 0) {
-                match_count++;
-                if (!best_match) {
-                    best_match = fs_files[i].name;
-                }
-            }
-        }
-        
-        // If we found exactly one match, complete it
-        if (match_count == 1 && best_match) {
-            // Clear the current command line
-            clear_input_line();
-            
-            // Extract just the filename without the path
-            char* filename = best_match;
-            char* last_slash = NULL;
-            
-            // Find the last backslash
-            for (int i = 0; best_match[i]; i++) {
-                if (best_match[i] == '\\') {
-                    last_slash = &best_match[i];
-                }
-            }
-            
-            if (last_slash) {
-                filename = last_slash + 1;
-            }
-            
-            // Reconstruct the command
-            strcpy(input_buffer, command);
-            strcat(input_buffer, " ");
-            
-            // Use relative path if in current dir, otherwise absolute
-            if (strncmp(best_match, fs_current_dir, strlen(fs_current_dir)) == 0) {
-                strcat(input_buffer, filename);
-            } else {
-                strcat(input_buffer, best_match);
-            }
-            
-            // Add a space after the filename for better usability
-            strcat(input_buffer, " ");
-            
-            buffer_position = strlen(input_buffer);
-            
-            // Display the updated command
-            vga_print(input_buffer);
-        }
+    // Like bash, a pattern with no match keeps showing the last hit
+    search_failed = age < 0;
+    if (!search_failed) {
+        search_age = age;
     }
 }
 
-// Simple argument parser - splits a command line into command and two arguments
-void parse_args(char* input, char* command, char* arg1, char* arg2) {
-    int i = 0;
-    int j = 0;
+// Leave search mode with the match as the line being edited
+static void reverse_search_finish(int accept) {
+    search_active = 0;
     
-    // First, extract the command
-    while (input[i] != ' ' && input[i] != '\0') {
-        command[j++] = input[i++];
+    if (accept && search_age >= 0) {
+        strcpy(input_buffer, history_entry(search_age));
+    } else {
+        strcpy(input_buffer, search_saved);
     }
-    command[j] = '\0';
+    buffer_position = strlen(input_buffer);
+    history_position = -1;
     
-    // If we've hit the end of the string, there are no arguments
-    if (input[i] == '\0') {
-        arg1[0] = '\0';
-        arg2[0] = '\0';
-        return;
+    redraw_input_line();
+}
+
+// Ctrl-R: start a search, or look further back if one is running
+void reverse_search_start(void) {
+    if (!search_active) {
+        input_buffer[buffer_position] = '\0';
+        strcpy(search_saved, input_buffer);
+        
+        search_active = 1;
+        search_failed = 0;
+        search_age = -1;
+        search_length = 0;
+        search_pattern[0] = '\0';
+    } else if (search_length > 0) {
+        reverse_search_step(search_age + 1);
     }
     
-    // Skip spaces
-    while (input[i] == ' ') {
-        i++;
+    reverse_search_draw();
+}
+
+// Feed a key to a running search. Returns 1 if the search used it; any other
+// key ends the search and is then handled as usual, so Enter runs the match.
+int reverse_search_key(char key) {
+    if (!search_active) {
+        return 0;
     }
     
-    // Extract first argument
-    j = 0;
-    while (input[i] != ' ' && input[i] != '\0') {
-        arg1[j++] = input[i++];
+    if (key == KEY_ESCAPE) {
+        reverse_search_finish(0);
+        return 1;
     }
-    arg1[j] = '\0';
     
-    // If we've hit the end of the string, there is no second argument
-    if (input[i] == '\0') {
-        arg2[0] = '\0';
-        return;
+    if (key == '\b') {
+        if (search_length > 0) {
+            search_pattern[--search_length] = '\0';
+            search_age = -1;
+            search_failed = 0;
+            if (search_length > 0) {
+                reverse_search_step(0);
+            }
+        }
+        reverse_search_draw();
+        return 1;
     }
     
-    // Skip spaces
-    while (input[i] == ' ') {
-        i++;
+    if (key >= ' ' && key <= '~') {
+        if (search_length < MAX_COMMAND_LENGTH - 1) {
+            search_pattern[search_length++] = key;
+            search_pattern[search_length] = '\0';
+            
+            // The current match may still contain the longer pattern
+            reverse_search_step(search_age < 0 ? 0 : search_age);
+        }
+        reverse_search_draw();
+        return 1;
     }
     
-    // Extract second argument
-    j = 0;
-    while (input[i] != ' ' && input[i] != '\0') {
-        arg2[j++] = input[i++];
+    reverse_search_finish(1);
+    return 0;
+}
+
+// Line as it stood after a Tab that had nothing to add, so a second Tab on
+// the same line lists the candidates instead
+static char tab_last_input[MAX_COMMAND_LENGTH];
+
+// Keep the per-command type filter: files for TYPE/DEL, directories for CD/MKDIR
+static int tab_type_matches(const fs_file_t* entry, int flags) {
+    if (flags & COMMAND_FILE_ARG) {
+        return entry->type == FS_FILE;
     }
-    arg2[j] = '\0';
+    if (flags & COMMAND_DIR_ARG) {
+        return entry->type == FS_DIRECTORY;
+    }
+    return 1;
 }
 
-void process_command() {
-    // Null-terminate the command
-    input_buffer[buffer_position] = '\0';
-    vga_println("");
+static void tab_list_candidates(const fs_file_t* dir, int first, int count, int flags, int matches) {
+    // Columns are as wide as the longest name plus two spaces
+    int width = 0;
+    for (int i = first; i < first + count; i++) {
+        fs_file_t* entry = fs_sorted_child(dir, i);
+        int length = strlen(fs_basename(entry));
+        if (tab_type_matches(entry, flags) && length > width) {
+            width = length;
+        }
+    }
+    width += 2;
     
-    // Check if the command is empty
-    if (input_buffer[0] == '\0') {
-        // Show prompt and return
-        vga_print(PROMPT_PREFIX);
-        vga_print(fs_current_dir);
-        vga_print(">");  // Removed space after '>'
-        return;
+    int columns = VGA_WIDTH / width;
+    if (columns < 1) {
+        columns = 1;
     }
     
-    // Special handling for the ECHO command which may contain spaces
-    if (strncmp(input_buffer, "echo ", 5) == 0 || 
-        strncmp(input_buffer, "ECHO ", 5) == 0 || 
-        strcmp(input_buffer, "echo") == 0 || 
-        strcmp(input_buffer, "ECHO") == 0) {
+    vga_println("");
+    
+    int shown = 0;
+    int column = 0;
+    for (int i = first; i < first + count && shown < TAB_LIST_MAX; i++) {
+        fs_file_t* entry = fs_sorted_child(dir, i);
+        if (!tab_type_matches(entry, flags)) {
+            continue;
+        }
+        
+        const char* name = fs_basename(entry);
+        vga_print(name);
+        shown++;
         
-        // If it's just "echo" with no arguments
-        if (strlen(input_buffer) == 4 || strlen(input_buffer) == 5) {
-            cmd_echo("");
+        if (++column == columns) {
+            vga_println("");
+            column = 0;
         } else {
-            // Pass everything after "echo " as the text argument
-            cmd_echo(input_buffer + 5);
+            for (int pad = strlen(name); pad < width; pad++) {
+                vga_putchar(' ');
+            }
         }
-        
-        // Show prompt and return
-        vga_print(PROMPT_PREFIX);
-        vga_print(fs_current_dir);
-        vga_print(">");
+    }
+    if (column != 0) {
+        vga_println("");
+    }
+    
+    if (shown < matches) {
+        char number[16];
+        itoa(matches - shown, number, 10);
+        vga_print("... and ");
+        vga_print(number);
+        vga_println(" more");
+    }
+    
+    // Put the prompt and the unfinished line back
+    vga_print(PROMPT_PREFIX);
+    vga_print(fs_current_dir);
+    vga_print(">");
+    vga_print(input_buffer);
+}
+
+// Complete the last word of the line against the names in its directory.
+// Each directory keeps its children sorted, so the candidates are one range
+// found by binary search rather than a scan over every entry.
+void handle_tab_completion() {
+    input_buffer[buffer_position] = '\0';
+    
+    // The command name itself isn't completed
+    int word = buffer_position;
+    while (word > 0 && input_buffer[word - 1] != ' ') {
+        word--;
+    }
+    if (word == 0) {
         return;
     }
     
-    // For other commands, use the existing parsing logic
-    char command[32];
-    char arg1[64];
-    char arg2[64];
-    parse_args(input_buffer, command, arg1, arg2);
+    char command[COMMAND_MAX_NAME];
+    int command_length = 0;
+    while (input_buffer[command_length] != ' ' && command_length < COMMAND_MAX_NAME - 1) {
+        char c = input_buffer[command_length];
+        command[command_length++] = (c >= 'A' && c <= 'Z') ? c + 32 : c;
+    }
+    command[command_length] = '\0';
+    
+    const command_t* completing = command_find(command);
+    int flags = completing ? completing->flags : 0;
     
-    // Convert command to lowercase for case-insensitive comparison
-    for (int i = 0; command[i]; i++) {
-        if (command[i] >= 'A' && command[i] <= 'Z') {
-            command[i] = command[i] + 32;
+    // Split the word into the directory to search and the name prefix
+    const char* partial = input_buffer + word;
+    const char* slash = strrchr(partial, '\\');
+    const char* prefix = slash ? slash + 1 : partial;
+    char dir_path[FS_MAX_FILENAME];
+    
+    if (!slash) {
+        strcpy(dir_path, fs_current_dir);
+    } else if (slash == partial) {
+        strcpy(dir_path, "\\");
+    } else {
+        char relative[FS_MAX_FILENAME];
+        int length = slash - partial;
+        if (strlen(fs_current_dir) + 1 + length >= FS_MAX_FILENAME) {
+            return;
         }
+        memcpy(relative, partial, length);
+        relative[length] = '\0';
+        resolve_path(relative, dir_path);
     }
     
-    if (strcmp(command, "version") == 0 || strcmp(command, "ver") == 0) {
-        cmd_version();
-    } else if (strcmp(command, "cls") == 0 || strcmp(command, "clear") == 0) {
-        vga_clear_screen();
-    } else if (strcmp(command, "help") == 0) {
-        cmd_help();
-    } else if (strcmp(command, "dir") == 0 || strcmp(command, "ls") == 0) {
-        if (arg1[0] == '\0') {
-            cmd_dir();
-        } else {
-            cmd_dir_path(arg1);
-        }
-    } else if (strcmp(command, "type") == 0 || strcmp(command, "cat") == 0) {
-        if (arg1[0] == '\0') {
-            vga_println("Syntax: TYPE <filename>");
-        } else {
-            cmd_type(arg1);
-        }
-    } else if (strcmp(command, "copy") == 0 || strcmp(command, "cp") == 0) {
-        if (arg1[0] == '\0' || arg2[0] == '\0') {
-            vga_println("Syntax: COPY <source> <destination>");
-        } else {
-            cmd_copy(arg1, arg2);
-        }
-    } else if (strcmp(command, "rename") == 0 || strcmp(command, "ren") == 0) {
-        if (arg1[0] == '\0' || arg2[0] == '\0') {
-            vga_println("Syntax: REN <oldname> <newname>");
-        } else {
-            cmd_rename(arg1, arg2);
-        }
-    } else if (strcmp(command, "move") == 0 || strcmp(command, "mv") == 0) {
-        if (arg1[0] == '\0' || arg2[0] == '\0') {
-            vga_println("Syntax: MOVE <source> <destination>");
-        } else {
-            cmd_move(arg1, arg2);
-        }
-    } else if (strcmp(command, "delete") == 0 || strcmp(command, "del") == 0) {
-        if (arg1[0] == '\0') {
-            vga_println("Syntax: DEL <filename>");
-        } else {
-            cmd_del(arg1);
-        }
-    } else if (strcmp(command, "mkdir") == 0 || strcmp(command, "md") == 0) {
-        if (arg1[0] == '\0') {
-            vga_println("Syntax: MKDIR <dirname>");
-        } else {
-            cmd_mkdir(arg1);
+    fs_file_t* dir = fs_find(dir_path);
+    if (!dir) {
+        return;
+    }
+    
+    int first;
+    int count = fs_prefix_range(dir, prefix, &first);
+    
+    // Longest common prefix of the candidates that pass the type filter
+    const char* common = NULL;
+    int common_length = 0;
+    int matches = 0;
+    
+    for (int i = first; i < first + count; i++) {
+        fs_file_t* entry = fs_sorted_child(dir, i);
+        if (!tab_type_matches(entry, flags)) {
+            continue;
         }
-    } else if (strcmp(command, "rmdir") == 0 || strcmp(command, "rd") == 0) {
-        if (arg1[0] == '\0') {
-            vga_println("Syntax: RMDIR <dirname>");
+        
+        const char* name = fs_basename(entry);
+        if (!common) {
+            common = name;
+            common_length = strlen(name);
         } else {
-            cmd_rmdir(arg1);
+            int length = 0;
+            while (length < common_length && name[length] == common[length]) {
+                length++;
+            }
+            common_length = length;
         }
-    } else if (strcmp(command, "touch") == 0) {
-        if (arg1[0] == '\0') {
-            vga_println("Syntax: TOUCH <filename>");
-        } else {
-            cmd_touch(arg1);
+        matches++;
+    }
+    
+    if (matches == 0) {
+        return;
+    }
+    
+    // Fill in what all candidates share, plus a space once it's unambiguous
+    int prefix_length = strlen(prefix);
+    int fill = common_length - prefix_length;
+    int added = fill + (matches == 1);
+    
+    if (added > 0) {
+        if (buffer_position + added >= MAX_COMMAND_LENGTH) {
+            return;
         }
-    } else if (strcmp(command, "rm") == 0) {
-        if (arg1[0] == '\0') {
-            vga_println("Syntax: RM <filename>");
-        } else {
-            cmd_rm(arg1);
+        
+        int start = buffer_position;
+        memcpy(input_buffer + buffer_position, common + prefix_length, fill);
+        buffer_position += fill;
+        if (matches == 1) {
+            input_buffer[buffer_position++] = ' ';
         }
-    } else if (strcmp(command, "cd") == 0 || strcmp(command, "chdir") == 0) {
-        cmd_cd(arg1);
-    } else if (strcmp(command, "colortest") == 0) {
-        cmd_colortest();
-    } else if (strlen(command) > 0) {
-        vga_print("Bad command or file name: ");
-        vga_println(command);
+        input_buffer[buffer_position] = '\0';
+        
+        vga_print(input_buffer + start);
+        tab_last_input[0] = '\0';
+        return;
+    }
+    
+    if (strcmp(tab_last_input, input_buffer) == 0) {
+        tab_list_candidates(dir, first, count, flags, matches);
+    } else {
+        strcpy(tab_last_input, input_buffer);
+    }
+}
+
+void process_command() {
+    // Null-terminate the command
+    input_buffer[buffer_position] = '\0';
+    vga_println("");
+    
+    if (input_buffer[0] != '\0') {
+        command_run(input_buffer);
     }
     
     buffer_position = 0;
     vga_print(PROMPT_PREFIX);
     vga_print(fs_current_dir);
-    vga_print(">");
+    vga_print(">");  // Removed space after '>'
 }
\ No newline at end of file
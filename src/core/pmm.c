@@ -0,0 +1,196 @@
+#include "pmm.h"
+#include "string.h"
+#include "types.h"
+
+// Start and end of the kernel image, from linker.ld
+extern char kernel_start[];
+extern char kernel_end[];
+
+// A set bit means the page is used or doesn't exist
+static uint32_t pmm_bitmap[PMM_MAX_PAGES / 32];
+static unsigned int pmm_total = 0;
+static unsigned int pmm_free = 0;
+
+// Lowest page that might be free, so allocations don't rescan low memory
+static unsigned int pmm_hint = 0;
+
+static inline int pmm_is_used(unsigned int page) {
+    return pmm_bitmap[page / 32] & (1u << (page % 32));
+}
+
+static inline void pmm_set(unsigned int page) {
+    pmm_bitmap[page / 32] |= 1u << (page % 32);
+}
+
+static inline void pmm_clear(unsigned int page) {
+    pmm_bitmap[page / 32] &= ~(1u << (page % 32));
+}
+
+// Hand pages that lie entirely inside [base, base + length) to the allocator
+static void pmm_release_range(uint64_t base, uint64_t length) {
+    uint64_t end = base + length;
+    if (end > (uint64_t)PMM_MAX_PAGES * PAGE_SIZE) {
+        end = (uint64_t)PMM_MAX_PAGES * PAGE_SIZE;
+    }
+
+    unsigned int first = (unsigned int)((base + PAGE_SIZE - 1) / PAGE_SIZE);
+    unsigned int last = (unsigned int)(end / PAGE_SIZE);
+
+    for (unsigned int page = first; page < last; page++) {
+        if (pmm_is_used(page)) {
+            pmm_clear(page);
+            pmm_total++;
+            pmm_free++;
+        }
+    }
+}
+
+// Take back every page overlapping [start, end)
+static void pmm_reserve_range(uint32_t start, uint32_t end) {
+    unsigned int first = start / PAGE_SIZE;
+    unsigned int last = (end + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    for (unsigned int page = first; page < last && page < PMM_MAX_PAGES; page++) {
+        if (!pmm_is_used(page)) {
+            pmm_set(page);
+            pmm_free--;
+        }
+    }
+}
+
+void pmm_init(uint32_t magic, multiboot_info_t* mbi) {
+    for (int i = 0; i < PMM_MAX_PAGES / 32; i++) {
+        pmm_bitmap[i] = 0xFFFFFFFF;
+    }
+    pmm_total = 0;
+    pmm_free = 0;
+
+    int have_info = (magic == MULTIBOOT_BOOTLOADER_MAGIC && mbi);
+
+    if (have_info && (mbi->flags & MULTIBOOT_INFO_MEM_MAP)) {
+        uint32_t address = mbi->mmap_addr;
+        uint32_t end = mbi->mmap_addr + mbi->mmap_length;
+
+        while (address < end) {
+            multiboot_mmap_entry_t* entry = (multiboot_mmap_entry_t*)address;
+            if (entry->type == MULTIBOOT_MEMORY_AVAILABLE) {
+                pmm_release_range(entry->base_addr, entry->length);
+            }
+            address += entry->size + sizeof(entry->size);
+        }
+    } else if (have_info && (mbi->flags & MULTIBOOT_INFO_MEMORY)) {
+        pmm_release_range(0x100000, (uint64_t)mbi->mem_upper * 1024);
+    } else {
+        pmm_release_range(0x100000, PMM_FALLBACK_MEMORY - 0x100000);
+    }
+
+    // Low memory holds the BIOS data area, VGA memory and ROMs
+    pmm_reserve_range(0, 0x100000);
+    pmm_reserve_range((uint32_t)kernel_start, (uint32_t)kernel_end);
+
+    // Keep whatever the bootloader handed over intact
+    if (have_info) {
+        pmm_reserve_range((uint32_t)mbi, (uint32_t)mbi + sizeof(multiboot_info_t));
+
+        if (mbi->flags & MULTIBOOT_INFO_MEM_MAP) {
+            pmm_reserve_range(mbi->mmap_addr, mbi->mmap_addr + mbi->mmap_length);
+        }
+
+        if (mbi->flags & MULTIBOOT_INFO_MODS) {
+            multiboot_module_t* mods = (multiboot_module_t*)mbi->mods_addr;
+            pmm_reserve_range(mbi->mods_addr, mbi->mods_addr + mbi->mods_count * sizeof(multiboot_module_t));
+            for (uint32_t i = 0; i < mbi->mods_count; i++) {
+                pmm_reserve_range(mods[i].mod_start, mods[i].mod_end);
+                if (mods[i].string) {
+                    pmm_reserve_range(mods[i].string, mods[i].string + strlen((const char*)mods[i].string) + 1);
+                }
+            }
+        }
+    }
+
+    pmm_hint = 0;
+}
+
+// First-fit search for `count` contiguous free pages
+void* pmm_alloc_pages(unsigned int count) {
+    unsigned int run = 0;
+    unsigned int first_free = PMM_MAX_PAGES;
+
+    if (count == 0 || count > pmm_free) {
+        return NULL;
+    }
+
+    for (unsigned int page = pmm_hint; page < PMM_MAX_PAGES; page++) {
+        // Skip whole words of used pages quickly
+        if (page % 32 == 0 && pmm_bitmap[page / 32] == 0xFFFFFFFF) {
+            run = 0;
+            page += 31;
+            continue;
+        }
+
+        if (pmm_is_used(page)) {
+            run = 0;
+            continue;
+        }
+
+        if (first_free == PMM_MAX_PAGES) {
+            first_free = page;
+        }
+
+        if (++run == count) {
+            unsigned int first = page + 1 - count;
+            for (unsigned int i = first; i <= page; i++) {
+                pmm_set(i);
+            }
+            pmm_free -= count;
+
+            // Nothing below the first free page we passed can be free
+            pmm_hint = (first_free == first) ? page + 1 : first_free;
+            return (void*)(first * PAGE_SIZE);
+        }
+    }
+
+    return NULL;
+}
+
+void pmm_free_pages(void* address, unsigned int count) {
+    unsigned int first = (uint32_t)address / PAGE_SIZE;
+
+    for (unsigned int page = first; page < first + count; page++) {
+        pmm_clear(page);
+    }
+    pmm_free += count;
+
+    if (first < pmm_hint) {
+        pmm_hint = first;
+    }
+}
+
+unsigned int pmm_total_pages(void) {
+    return pmm_total;
+}
+
+unsigned int pmm_free_page_count(void) {
+    return pmm_free;
+}
+
+unsigned int pmm_largest_free_run(void) {
+    unsigned int largest = 0;
+    unsigned int run = 0;
+
+    for (unsigned int page = 0; page < PMM_MAX_PAGES; page++) {
+        if (page % 32 == 0 && pmm_bitmap[page / 32] == 0xFFFFFFFF) {
+            run = 0;
+            page += 31;
+            continue;
+        }
+
+        if (pmm_is_used(page)) {
+            run = 0;
+        } else if (++run > largest) {
+            largest = run;
+        }
+    }
+
+    return largest;
+}
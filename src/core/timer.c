@@ -0,0 +1,85 @@
+#include "timer.h"
+#include "idt.h"
+#include "io.h"
+#include "string.h"
+#include "types.h"
+
+// Bumped by the IRQ 0 handler; 32 bits so reads can't tear
+static volatile uint32_t timer_tick_count = 0;
+
+static uint32_t timer_khz = 0;
+static uint64_t timer_tsc_base = 0;
+
+static void timer_irq_handler(void) {
+    timer_tick_count++;
+}
+
+// Count TSC cycles across a fixed one-shot on PIT channel 2. This polls the
+// channel's output pin, so it works before interrupts are enabled.
+static uint32_t timer_calibrate_tsc(void) {
+    uint16_t count = PIT_FREQUENCY / (1000 / TIMER_CALIBRATE_MS);
+    
+    // Gate on, speaker off
+    outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~0x02) | 0x01);
+    
+    // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2, count & 0xFF);
+    outb(PIT_CHANNEL2, count >> 8);
+    
+    // Restart the count by pulsing the gate
+    unsigned char gate = inb(PIT_GATE_PORT) & ~0x01;
+    outb(PIT_GATE_PORT, gate);
+    outb(PIT_GATE_PORT, gate | 0x01);
+    
+    uint64_t start = rdtsc();
+    while (!(inb(PIT_GATE_PORT) & 0x20)) {
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    return (uint32_t)udiv64(cycles, TIMER_CALIBRATE_MS, NULL);
+}
+
+void timer_init(void) {
+    timer_khz = timer_calibrate_tsc();
+    timer_tsc_base = rdtsc();
+    
+    // Channel 0, lobyte/hibyte, mode 2 (rate generator)
+    uint16_t divisor = PIT_FREQUENCY / TIMER_HZ;
+    outb(PIT_COMMAND, 0x34);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, divisor >> 8);
+    
+    timer_tick_count = 0;
+    irq_install_handler(IRQ_TIMER, timer_irq_handler);
+}
+
+uint32_t timer_ticks(void) {
+    return timer_tick_count;
+}
+
+uint32_t timer_tsc_khz(void) {
+    return timer_khz;
+}
+
+// Split the division so cycles * 10^6 never overflows
+uint64_t timer_cycles_to_ns(uint64_t cycles) {
+    uint32_t remainder;
+    
+    if (timer_khz == 0) {
+        return 0;
+    }
+    
+    uint64_t ms = udiv64(cycles, timer_khz, &remainder);
+    return ms * 1000000 + udiv64((uint64_t)remainder * 1000000, timer_khz, NULL);
+}
+
+// Nanoseconds since timer_init(), from the TSC when it could be calibrated
+// and the PIT tick otherwise
+uint64_t timer_now_ns(void) {
+    if (timer_khz == 0) {
+        return (uint64_t)timer_ticks() * (1000000000 / TIMER_HZ);
+    }
+    
+    return timer_cycles_to_ns(rdtsc() - timer_tsc_base);
+}
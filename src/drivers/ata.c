@@ -0,0 +1,226 @@
+#include "ata.h"
+#include "io.h"
+#include "string.h"
+#include "types.h"
+
+static int ata_found = 0;
+static uint32_t ata_sectors = 0;
+static char ata_model_name[ATA_MODEL_LENGTH + 1];
+
+// Reading the alternate status port takes about 100ns; four of them give
+// the drive the 400ns it needs after a command or drive select
+static void ata_delay(void) {
+    for (int i = 0; i < 4; i++) {
+        inb(ATA_PRIMARY_CONTROL);
+    }
+}
+
+static int ata_wait_not_busy(void) {
+    for (int i = 0; i < ATA_TIMEOUT; i++) {
+        if (!(inb(ATA_PRIMARY_IO + ATA_REG_STATUS) & ATA_STATUS_BSY)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Wait until the drive is ready to move a sector of data
+static int ata_wait_data(void) {
+    for (int i = 0; i < ATA_TIMEOUT; i++) {
+        unsigned char status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+        if (status & ATA_STATUS_BSY) {
+            continue;
+        }
+        if (status & (ATA_STATUS_ERR | ATA_STATUS_DF)) {
+            return 0;
+        }
+        if (status & ATA_STATUS_DRQ) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Wait for a command to finish and report whether the drive took it
+static int ata_wait_done(void) {
+    if (!ata_wait_not_busy()) {
+        return 0;
+    }
+    return !(inb(ATA_PRIMARY_IO + ATA_REG_STATUS) & (ATA_STATUS_ERR | ATA_STATUS_DF));
+}
+
+static void ata_issue(unsigned char command, uint32_t lba, unsigned int count) {
+    outb(ATA_PRIMARY_IO + ATA_REG_DRIVE, ATA_DRIVE_MASTER_LBA | ((lba >> 24) & 0x0F));
+    outb(ATA_PRIMARY_IO + ATA_REG_SECTOR_COUNT, count & 0xFF);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA_LOW, lba & 0xFF);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA_MID, (lba >> 8) & 0xFF);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA_HIGH, (lba >> 16) & 0xFF);
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, command);
+    ata_delay();
+}
+
+// Detect the primary master with IDENTIFY DEVICE. Returns 1 if a usable
+// ATA disk is there.
+int ata_init(void) {
+    uint16_t identify[ATA_SECTOR_SIZE / 2];
+    
+    ata_found = 0;
+    ata_sectors = 0;
+    ata_model_name[0] = '\0';
+    
+    // A floating bus reads back 0xFF: no controller at all
+    if (inb(ATA_PRIMARY_IO + ATA_REG_STATUS) == 0xFF) {
+        return 0;
+    }
+    
+    outb(ATA_PRIMARY_CONTROL, ATA_CONTROL_NIEN);
+    outb(ATA_PRIMARY_IO + ATA_REG_DRIVE, ATA_DRIVE_MASTER_LBA);
+    ata_delay();
+    
+    ata_issue(ATA_CMD_IDENTIFY, 0, 0);
+    if (inb(ATA_PRIMARY_IO + ATA_REG_STATUS) == 0 || !ata_wait_not_busy()) {
+        return 0;
+    }
+    
+    // ATAPI and SATA devices answer with a signature instead of data
+    if (inb(ATA_PRIMARY_IO + ATA_REG_LBA_MID) != 0 || inb(ATA_PRIMARY_IO + ATA_REG_LBA_HIGH) != 0) {
+        return 0;
+    }
+    if (!ata_wait_data()) {
+        return 0;
+    }
+    insw(ATA_PRIMARY_IO + ATA_REG_DATA, identify, ATA_SECTOR_SIZE / 2);
+    
+    // Words 60-61 hold the number of LBA28 sectors
+    ata_sectors = identify[60] | ((uint32_t)identify[61] << 16);
+    if (ata_sectors == 0) {
+        return 0;
+    }
+    
+    // Words 27-46 hold the model, two characters per word, high byte first
+    int length = 0;
+    for (int i = 0; i < ATA_MODEL_LENGTH / 2; i++) {
+        ata_model_name[length++] = identify[27 + i] >> 8;
+        ata_model_name[length++] = identify[27 + i] & 0xFF;
+    }
+    while (length > 0 && ata_model_name[length - 1] == ' ') {
+        length--;
+    }
+    ata_model_name[length] = '\0';
+    
+    strcpy(ata_device.name, ata_model_name);
+    ata_device.sectors = ata_sectors;
+    ata_found = 1;
+    return 1;
+}
+
+int ata_present(void) {
+    return ata_found;
+}
+
+uint32_t ata_sector_count(void) {
+    return ata_sectors;
+}
+
+const char* ata_model(void) {
+    return ata_model_name;
+}
+
+static int ata_in_range(uint32_t lba, unsigned int count) {
+    return ata_found && count > 0 && lba < ata_sectors && count <= ata_sectors - lba;
+}
+
+// Multi-sector commands pay the command overhead once per
+// ATA_MAX_TRANSFER sectors rather than once per sector
+int ata_read_sectors(uint32_t lba, unsigned int count, void* buffer) {
+    if (!ata_in_range(lba, count)) {
+        return 0;
+    }
+    
+    uint8_t* data = buffer;
+    while (count > 0) {
+        unsigned int chunk = count < ATA_MAX_TRANSFER ? count : ATA_MAX_TRANSFER;
+        
+        ata_issue(ATA_CMD_READ_SECTORS, lba, chunk);
+        for (unsigned int i = 0; i < chunk; i++) {
+            if (!ata_wait_data()) {
+                return 0;
+            }
+            insw(ATA_PRIMARY_IO + ATA_REG_DATA, data, ATA_SECTOR_SIZE / 2);
+            data += ATA_SECTOR_SIZE;
+        }
+        
+        lba += chunk;
+        count -= chunk;
+    }
+    return 1;
+}
+
+int ata_write_sectors(uint32_t lba, unsigned int count, const void* buffer) {
+    if (!ata_in_range(lba, count)) {
+        return 0;
+    }
+    
+    const uint16_t* data = buffer;
+    while (count > 0) {
+        unsigned int chunk = count < ATA_MAX_TRANSFER ? count : ATA_MAX_TRANSFER;
+        
+        ata_issue(ATA_CMD_WRITE_SECTORS, lba, chunk);
+        for (unsigned int i = 0; i < chunk; i++) {
+            if (!ata_wait_data()) {
+                return 0;
+            }
+            // One word at a time: rep outsw can outrun real drives
+            for (int word = 0; word < ATA_SECTOR_SIZE / 2; word++) {
+                outw(ATA_PRIMARY_IO + ATA_REG_DATA, *data++);
+            }
+        }
+        
+        // The drive reports a failed write of the last sector only here
+        if (!ata_wait_done()) {
+            return 0;
+        }
+        
+        lba += chunk;
+        count -= chunk;
+    }
+    return 1;
+}
+
+// Ask the drive to commit its own write cache to the medium
+int ata_flush(void) {
+    if (!ata_found) {
+        return 0;
+    }
+    
+    outb(ATA_PRIMARY_IO + ATA_REG_DRIVE, ATA_DRIVE_MASTER_LBA);
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, ATA_CMD_CACHE_FLUSH);
+    ata_delay();
+    
+    return ata_wait_done();
+}
+
+// PIO runs one command at a time, so a batch just goes in order
+static int ata_submit(blockdev_request_t* requests, int count, unsigned int depth) {
+    int succeeded = 0;
+    
+    (void)depth;
+    for (int i = 0; i < count; i++) {
+        blockdev_request_t* request = &requests[i];
+        request->ok = request->write ? ata_write_sectors(request->lba, request->count, request->buffer)
+                                     : ata_read_sectors(request->lba, request->count, request->buffer);
+        succeeded += request->ok;
+    }
+    return succeeded;
+}
+
+blockdev_t ata_device = {
+    "",
+    0,
+    ATA_MAX_TRANSFER,
+    1,
+    ata_read_sectors,
+    ata_write_sectors,
+    ata_flush,
+    ata_submit,
+};
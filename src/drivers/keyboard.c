@@ -1,7 +1,9 @@
 #include "keyboard.h"
+#include "idt.h"
 #include "io.h"
 #include "vga.h"
 #include "kernel.h"
+#include "history.h"
 #include "filesystem.h"
 #include "string.h"
 #include "types.h"
@@ -25,21 +27,52 @@ static int ctrl_pressed = 0;
 static int extended_key = 0;
 static unsigned char last_scancode = 0;
 
+// Single-producer/single-consumer ring: the IRQ1 handler only advances
+// scancode_head and the shell loop only advances scancode_tail.
+static volatile unsigned char scancode_buffer[KEYBOARD_BUFFER_SIZE];
+static volatile unsigned int scancode_head = 0;
+static volatile unsigned int scancode_tail = 0;
+
+static void keyboard_irq_handler(void) {
+    // Always read the port, otherwise the controller stops raising IRQ1
+    unsigned char scancode = inb(KEYBOARD_DATA_PORT);
+    unsigned int head = scancode_head;
+
+    // Drop the scancode if the shell has fallen a full buffer behind
+    if (head - scancode_tail < KEYBOARD_BUFFER_SIZE) {
+        scancode_buffer[head & (KEYBOARD_BUFFER_SIZE - 1)] = scancode;
+        __asm__ volatile("" ::: "memory");
+        scancode_head = head + 1;
+    }
+}
+
 void keyboard_init(void) {
     last_scancode = 0;
     extended_key = 0;
     ctrl_pressed = 0;
+    scancode_head = 0;
+    scancode_tail = 0;
+
+    // Discard anything the controller buffered before the IRQ was wired up
+    while (inb(KEYBOARD_STATUS_PORT) & 1) {
+        inb(KEYBOARD_DATA_PORT);
+    }
+
+    irq_install_handler(IRQ_KEYBOARD, keyboard_irq_handler);
 }
 
-// Check if there's a key available to read
+// Check if there's a scancode waiting in the ring buffer
 int keyboard_is_key_available(void) {
-    // Check bit 0 of the keyboard status port
-    // If it's 1, there's data available to read
-    return inb(KEYBOARD_STATUS_PORT) & 1;
+    return scancode_tail != scancode_head;
 }
 
+// Pop the next scancode; callers check keyboard_is_key_available() first
 unsigned char keyboard_get_scancode(void) {
-    return inb(KEYBOARD_DATA_PORT);
+    unsigned int tail = scancode_tail;
+    unsigned char scancode = scancode_buffer[tail & (KEYBOARD_BUFFER_SIZE - 1)];
+    __asm__ volatile("" ::: "memory");
+    scancode_tail = tail + 1;
+    return scancode;
 }
 
 char keyboard_scancode_to_ascii(unsigned char scancode) {
@@ -92,9 +125,9 @@ char keyboard_scancode_to_ascii(unsigned char scancode) {
         return 0;
     }
     
-    // Tab key
-    if (scancode == KEY_TAB) {
-        return KEY_TAB;
+    // Tab and Escape share their scancode with their key code
+    if (scancode == KEY_TAB || scancode == KEY_ESCAPE) {
+        return scancode;
     }
     
     // Regular keys
@@ -125,69 +158,78 @@ void clear_input_line(void) {
     vga_update_cursor();
 }
 
-void keyboard_handler(void) {
-    // Only read if a key is actually available
-    if (keyboard_is_key_available()) {
-        unsigned char scancode = keyboard_get_scancode();
-        
-        // Store scancode for debugging if needed
-        last_scancode = scancode;
-        
-        // Extended key sequence starts with 0xE0
-        if (scancode == 0xE0) {
-            extended_key = 1;
-            return; // Wait for the next scancode
+static void keyboard_process_scancode(unsigned char scancode) {
+    // Store scancode for debugging if needed
+    last_scancode = scancode;
+    
+    // Extended key sequence starts with 0xE0
+    if (scancode == 0xE0) {
+        extended_key = 1;
+        return; // Wait for the next scancode
+    }
+    
+    char key = keyboard_scancode_to_ascii(scancode);
+    
+    // Only process key press events (not key release)
+    if (key && !(scancode & 0x80)) {
+        // Ctrl-R searches history backwards; while a search is running it
+        // gets first look at every key
+        if (ctrl_pressed && (key == 'r' || key == 'R')) {
+            reverse_search_start();
         }
-        
-        char key = keyboard_scancode_to_ascii(scancode);
-        
-        // Only process key press events (not key release)
-        if (key && !(scancode & 0x80)) {
-            // Handle special keys
-            if (key == KEY_UP) {
-                // Navigate up through command history
-                navigate_history(-1);
-            }
-            else if (key == KEY_DOWN) {
-                // Navigate down through command history
-                navigate_history(1);
-            }
-            else if (key == KEY_TAB) {
-                // Handle tab completion
-                handle_tab_completion();
-            }
-            // Handle backspace
-            else if (key == '\b') {
-                if (buffer_position > 0) {
-                    buffer_position--;
-                    vga_cursor_x--;
-                    if (vga_cursor_x < 0) {
-                        vga_cursor_x = VGA_WIDTH - 1;
-                        vga_cursor_y--;
-                    }
-                    const int index = vga_cursor_y * VGA_WIDTH + vga_cursor_x;
-                    vga_buffer[index] = vga_entry(' ', vga_color);
-                    vga_update_cursor();
-                }
-            }
-            // Handle enter key
-            else if (key == '\n') {
-                input_buffer[buffer_position] = '\0';
-                
-                // Add command to history if it's not empty
-                if (buffer_position > 0) {
-                    add_to_history(input_buffer);
+        else if (reverse_search_key(key)) {
+            // Consumed by the search
+        }
+        // Handle special keys
+        else if (key == KEY_UP) {
+            // Navigate up to older commands
+            navigate_history(1);
+        }
+        else if (key == KEY_DOWN) {
+            // Navigate down to newer commands
+            navigate_history(-1);
+        }
+        else if (key == KEY_TAB) {
+            // Handle tab completion
+            handle_tab_completion();
+        }
+        // Handle backspace
+        else if (key == '\b') {
+            if (buffer_position > 0) {
+                buffer_position--;
+                vga_cursor_x--;
+                if (vga_cursor_x < 0) {
+                    vga_cursor_x = VGA_WIDTH - 1;
+                    vga_cursor_y--;
                 }
-                
-                process_command();
-                buffer_position = 0;
-                history_position = -1;
+                vga_putchar_at(' ', vga_cursor_x, vga_cursor_y);
+                vga_update_cursor();
             }
-            // Handle regular characters
-            else if (buffer_position < MAX_COMMAND_LENGTH - 1) {
-                input_buffer[buffer_position++] = key;
-                vga_putchar(key);
+        }
+        // Handle enter key
+        else if (key == '\n') {
+            input_buffer[buffer_position] = '\0';
+            
+            // Add command to history if it's not empty
+            if (buffer_position > 0) {
+                history_add(input_buffer);
             }
+            
+            process_command();
+            buffer_position = 0;
+            history_position = -1;
+        }
+        // Handle regular characters
+        else if (key >= ' ' && buffer_position < MAX_COMMAND_LENGTH - 1) {
+            input_buffer[buffer_position++] = key;
+            vga_putchar(key);
         }
     }
+}
+
+// Drain every scancode the IRQ handler has queued since the last call
+void keyboard_handler(void) {
+    while (keyboard_is_key_available()) {
+        keyboard_process_scancode(keyboard_get_scancode());
+    }
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "pci.h"
+#include "io.h"
+#include "types.h"
+
+static pci_device_t pci_devices[PCI_MAX_FOUND];
+static int pci_count = 0;
+
+static uint32_t pci_address(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
+    return PCI_ENABLE | (uint32_t)bus << 16 | (uint32_t)device << 11 | (uint32_t)function << 8 | (offset & 0xFC);
+}
+
+static uint32_t pci_config_read(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
+    outl(PCI_CONFIG_ADDRESS, pci_address(bus, device, function, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+uint32_t pci_read32(const pci_device_t* dev, uint8_t offset) {
+    return pci_config_read(dev->bus, dev->device, dev->function, offset);
+}
+
+uint16_t pci_read16(const pci_device_t* dev, uint8_t offset) {
+    return pci_read32(dev, offset) >> ((offset & 2) * 8);
+}
+
+uint8_t pci_read8(const pci_device_t* dev, uint8_t offset) {
+    return pci_read32(dev, offset) >> ((offset & 3) * 8);
+}
+
+void pci_write32(const pci_device_t* dev, uint8_t offset, uint32_t value) {
+    outl(PCI_CONFIG_ADDRESS, pci_address(dev->bus, dev->device, dev->function, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+// Config writes are whole dwords, so merge with the other half
+void pci_write16(const pci_device_t* dev, uint8_t offset, uint16_t value) {
+    int shift = (offset & 2) * 8;
+    uint32_t dword = pci_read32(dev, offset);
+    dword = (dword & ~(0xFFFFu << shift)) | (uint32_t)value << shift;
+    pci_write32(dev, offset, dword);
+}
+
+// Turn on I/O decoding, memory decoding and/or DMA for a device
+void pci_enable(const pci_device_t* dev, uint16_t command_bits) {
+    pci_write16(dev, PCI_COMMAND, pci_read16(dev, PCI_COMMAND) | command_bits);
+}
+
+static void pci_add(uint8_t bus, uint8_t device, uint8_t function, uint32_t id) {
+    if (pci_count == PCI_MAX_FOUND) {
+        return;
+    }
+    
+    pci_device_t* dev = &pci_devices[pci_count++];
+    dev->bus = bus;
+    dev->device = device;
+    dev->function = function;
+    dev->vendor_id = id & 0xFFFF;
+    dev->device_id = id >> 16;
+    dev->class_code = pci_read8(dev, PCI_CLASS);
+    dev->subclass = pci_read8(dev, PCI_SUBCLASS);
+}
+
+// Probe every bus and slot once at boot. Functions other than 0 are only
+// looked at when function 0 says the device has them.
+int pci_init(void) {
+    pci_count = 0;
+    
+    for (int bus = 0; bus < PCI_MAX_BUSES; bus++) {
+        for (int device = 0; device < PCI_MAX_DEVICES; device++) {
+            uint32_t id = pci_config_read(bus, device, 0, PCI_VENDOR_ID);
+            if ((id & 0xFFFF) == PCI_VENDOR_NONE) {
+                continue;
+            }
+            pci_add(bus, device, 0, id);
+            
+            uint32_t header = pci_config_read(bus, device, 0, PCI_HEADER_TYPE) >> 16;
+            if (!(header & PCI_HEADER_MULTIFUNCTION)) {
+                continue;
+            }
+            for (int function = 1; function < PCI_MAX_FUNCTIONS; function++) {
+                id = pci_config_read(bus, device, function, PCI_VENDOR_ID);
+                if ((id & 0xFFFF) != PCI_VENDOR_NONE) {
+                    pci_add(bus, device, function, id);
+                }
+            }
+        }
+    }
+    return pci_count;
+}
+
+const pci_device_t* pci_find(uint16_t vendor_id, uint16_t device_id) {
+    for (int i = 0; i < pci_count; i++) {
+        if (pci_devices[i].vendor_id == vendor_id && pci_devices[i].device_id == device_id) {
+            return &pci_devices[i];
+        }
+    }
+    return NULL;
+}
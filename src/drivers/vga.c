@@ -8,6 +8,20 @@ int vga_cursor_x;
 int vga_cursor_y;
 unsigned char vga_color;
 
+// Off-screen copy of the cell grid; rows reach MMIO only in vga_flush().
+// It is a ring of rows so scrolling only moves vga_shadow_top.
+static unsigned short vga_shadow[VGA_WIDTH * VGA_HEIGHT] __attribute__((aligned(4)));
+static int vga_shadow_top = 0;
+static uint32_t vga_dirty_rows = 0;
+static int vga_cursor_dirty = 0;
+
+// Cell offset of the visible window inside the 32 KB of text memory
+static int vga_origin = 0;
+static int vga_origin_dirty = 0;
+static int vga_scroll_mode = VGA_SCROLL_HARDWARE;
+
+#define VGA_ALL_ROWS ((1u << VGA_HEIGHT) - 1)
+
 unsigned char vga_entry_color(enum vga_color fg, enum vga_color bg) {
     return fg | bg << 4;
 }
@@ -16,15 +30,56 @@ unsigned short vga_entry(unsigned char c, unsigned char color) {
     return (unsigned short) c | (unsigned short) color << 8;
 }
 
+static inline unsigned short* vga_shadow_row(int y) {
+    int row = vga_shadow_top + y;
+    if (row >= VGA_HEIGHT) {
+        row -= VGA_HEIGHT;
+    }
+    return &vga_shadow[row * VGA_WIDTH];
+}
+
+static void vga_crtc_write(unsigned char reg, unsigned char value) {
+    outb(VGA_CRTC_ADDR_REG, reg);
+    outb(VGA_CRTC_DATA_REG, value);
+}
+
+// Cursor moves are batched too; the registers are written once per flush
 void vga_update_cursor(void) {
-    // Calculate cursor position
-    unsigned short pos = vga_cursor_y * VGA_WIDTH + vga_cursor_x;
+    vga_cursor_dirty = 1;
+}
+
+static void vga_write_cursor(void) {
+    // The cursor position is absolute in text memory, not window-relative
+    unsigned short pos = vga_origin + vga_cursor_y * VGA_WIDTH + vga_cursor_x;
     
-    // Set cursor position via VGA registers
-    outb(VGA_CRTC_ADDR_REG, VGA_CURSOR_LOC_LOW);
-    outb(VGA_CRTC_DATA_REG, (unsigned char)(pos & 0xFF));
-    outb(VGA_CRTC_ADDR_REG, VGA_CURSOR_LOC_HIGH);
-    outb(VGA_CRTC_DATA_REG, (unsigned char)((pos >> 8) & 0xFF));
+    vga_crtc_write(VGA_CURSOR_LOC_LOW, (unsigned char)(pos & 0xFF));
+    vga_crtc_write(VGA_CURSOR_LOC_HIGH, (unsigned char)((pos >> 8) & 0xFF));
+}
+
+// Copy dirty rows from the shadow grid to video memory and sync the
+// start address and cursor registers
+void vga_flush(void) {
+    uint32_t dirty = vga_dirty_rows;
+    vga_dirty_rows = 0;
+    
+    for (int y = 0; dirty; y++, dirty >>= 1) {
+        if (!(dirty & 1)) {
+            continue;
+        }
+        
+        memcpy((void*)&vga_buffer[vga_origin + y * VGA_WIDTH], vga_shadow_row(y), VGA_WIDTH * 2);
+    }
+    
+    if (vga_origin_dirty) {
+        vga_origin_dirty = 0;
+        vga_crtc_write(VGA_START_ADDR_HIGH, (unsigned char)((vga_origin >> 8) & 0xFF));
+        vga_crtc_write(VGA_START_ADDR_LOW, (unsigned char)(vga_origin & 0xFF));
+    }
+    
+    if (vga_cursor_dirty) {
+        vga_cursor_dirty = 0;
+        vga_write_cursor();
+    }
 }
 
 void vga_init(void) {
@@ -34,40 +89,67 @@ void vga_init(void) {
     vga_color = vga_entry_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     
     vga_clear_screen();
-    vga_update_cursor();
 }
 
 void vga_set_color(enum vga_color fg, enum vga_color bg) {
     vga_color = vga_entry_color(fg, bg);
 }
 
-void vga_clear_screen(void) {
-    for (int y = 0; y < VGA_HEIGHT; y++) {
-        for (int x = 0; x < VGA_WIDTH; x++) {
-            const int index = y * VGA_WIDTH + x;
-            vga_buffer[index] = vga_entry(' ', vga_color);
-        }
+// Switch between moving the CRTC window and copying every row on scroll
+void vga_set_scroll_mode(int mode) {
+    vga_scroll_mode = mode;
+    
+    // Copy mode always draws at the start of text memory
+    if (mode == VGA_SCROLL_COPY && vga_origin != 0) {
+        vga_origin = 0;
+        vga_origin_dirty = 1;
+        vga_dirty_rows = VGA_ALL_ROWS;
+        vga_cursor_dirty = 1;
     }
+}
+
+int vga_get_scroll_mode(void) {
+    return vga_scroll_mode;
+}
+
+void vga_clear_screen(void) {
+    memsetw(vga_shadow, vga_entry(' ', vga_color), VGA_WIDTH * VGA_HEIGHT);
     
+    vga_shadow_top = 0;
+    vga_origin = 0;
+    vga_origin_dirty = 1;
+    vga_dirty_rows = VGA_ALL_ROWS;
     vga_cursor_x = 0;
     vga_cursor_y = 0;
     vga_update_cursor();
+    vga_flush();
 }
 
 void vga_scroll(void) {
-    // Move everything up one line
-    for (int y = 0; y < VGA_HEIGHT - 1; y++) {
-        for (int x = 0; x < VGA_WIDTH; x++) {
-            const int dst_index = y * VGA_WIDTH + x;
-            const int src_index = (y + 1) * VGA_WIDTH + x;
-            vga_buffer[dst_index] = vga_buffer[src_index];
-        }
+    // Rotate the shadow ring so the old top row becomes the new bottom row
+    vga_shadow_top++;
+    if (vga_shadow_top == VGA_HEIGHT) {
+        vga_shadow_top = 0;
     }
     
     // Clear the last line
-    for (int x = 0; x < VGA_WIDTH; x++) {
-        const int index = (VGA_HEIGHT - 1) * VGA_WIDTH + x;
-        vga_buffer[index] = vga_entry(' ', vga_color);
+    memsetw(vga_shadow_row(VGA_HEIGHT - 1), vga_entry(' ', vga_color), VGA_WIDTH);
+    
+    if (vga_scroll_mode == VGA_SCROLL_HARDWARE) {
+        // Slide the window down one row; only the new bottom row needs drawing
+        vga_origin += VGA_WIDTH;
+        vga_origin_dirty = 1;
+        
+        if (vga_origin + VGA_WIDTH * VGA_HEIGHT > VGA_TEXT_MEMORY_CELLS) {
+            // Window ran off the end of text memory, redraw it at the start
+            vga_origin = 0;
+            vga_dirty_rows = VGA_ALL_ROWS;
+        } else {
+            vga_dirty_rows = (vga_dirty_rows >> 1) | (1u << (VGA_HEIGHT - 1));
+        }
+    } else {
+        // Every visible row moved
+        vga_dirty_rows = VGA_ALL_ROWS;
     }
     
     // Move cursor up
@@ -97,9 +179,9 @@ void vga_putchar(char c) {
         return;
     }
     
-    // Write character to VGA buffer
-    int index = vga_cursor_y * VGA_WIDTH + vga_cursor_x;
-    vga_buffer[index] = vga_entry(c, vga_color);
+    // Write character to the shadow grid
+    vga_shadow_row(vga_cursor_y)[vga_cursor_x] = vga_entry(c, vga_color);
+    vga_dirty_rows |= 1u << vga_cursor_y;
     
     // Move cursor
     vga_cursor_x++;
@@ -116,10 +198,17 @@ void vga_putchar(char c) {
     vga_update_cursor();
 }
 
+// Write a character at a fixed position without moving the cursor
+void vga_putchar_at(char c, int x, int y) {
+    vga_shadow_row(y)[x] = vga_entry(c, vga_color);
+    vga_dirty_rows |= 1u << y;
+}
+
 void vga_write(const char* data, int size) {
     for (int i = 0; i < size; i++) {
         vga_putchar(data[i]);
     }
+    vga_flush();
 }
 
 void vga_print(const char* str) {
@@ -127,6 +216,10 @@ void vga_print(const char* str) {
 }
 
 void vga_println(const char* str) {
-    vga_print(str);
+    int size = strlen(str);
+    for (int i = 0; i < size; i++) {
+        vga_putchar(str[i]);
+    }
     vga_putchar('\n');
+    vga_flush();
 }
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include "virtio_blk.h"
+#include "heap.h"
+#include "io.h"
+#include "pci.h"
+#include "pmm.h"
+#include "string.h"
+#include "types.h"
+
+static int virtio_blk_found = 0;
+static int virtio_blk_can_flush = 0;
+static uint16_t virtio_blk_io;
+
+// The virtqueue: descriptor table and available ring, then the used ring
+// on the next page boundary. Memory is identity mapped, so pointers are
+// the physical addresses the device wants.
+static uint16_t virtio_blk_queue_size;
+static virtq_desc_t* virtio_blk_desc;
+static volatile virtq_avail_t* virtio_blk_avail;
+static volatile virtq_used_t* virtio_blk_used;
+static uint16_t virtio_blk_last_used;
+
+// Request slots, each with its header and status byte
+static unsigned int virtio_blk_slots;
+static int virtio_blk_free[VIRTIO_BLK_MAX_DEPTH];
+static int virtio_blk_free_count;
+static virtio_blk_header_t virtio_blk_headers[VIRTIO_BLK_MAX_DEPTH];
+static volatile uint8_t virtio_blk_status[VIRTIO_BLK_MAX_DEPTH];
+static blockdev_request_t* virtio_blk_pending[VIRTIO_BLK_MAX_DEPTH];
+
+// Keep the compiler from moving ring stores across each other; x86 does
+// not reorder them on its own
+static inline void virtio_blk_barrier(void) {
+    __asm__ volatile("" : : : "memory");
+}
+
+// Fill in a slot's descriptor chain and put it on the available ring. The
+// device only hears about it at the next notify.
+static void virtio_blk_post(int slot, uint32_t type, uint32_t lba, unsigned int count, void* buffer) {
+    int head = slot * VIRTIO_BLK_CHAIN;
+    virtq_desc_t* desc = &virtio_blk_desc[head];
+    virtio_blk_header_t* header = &virtio_blk_headers[slot];
+    
+    header->type = type;
+    header->reserved = 0;
+    header->sector = lba;
+    virtio_blk_status[slot] = 0xFF;
+    
+    desc[0].address = (uintptr_t)header;
+    desc[0].length = sizeof(virtio_blk_header_t);
+    desc[0].flags = VIRTQ_DESC_F_NEXT;
+    desc[0].next = head + 2;
+    
+    if (count > 0) {
+        desc[0].next = head + 1;
+        desc[1].address = (uintptr_t)buffer;
+        desc[1].length = count * BLOCKDEV_SECTOR_SIZE;
+        desc[1].flags = VIRTQ_DESC_F_NEXT | (type == VIRTIO_BLK_T_IN ? VIRTQ_DESC_F_WRITE : 0);
+        desc[1].next = head + 2;
+    }
+    
+    desc[2].address = (uintptr_t)&virtio_blk_status[slot];
+    desc[2].length = 1;
+    desc[2].flags = VIRTQ_DESC_F_WRITE;
+    desc[2].next = 0;
+    
+    virtio_blk_avail->ring[virtio_blk_avail->index & (virtio_blk_queue_size - 1)] = head;
+    virtio_blk_barrier();
+    virtio_blk_avail->index++;
+}
+
+static void virtio_blk_notify(void) {
+    virtio_blk_barrier();
+    outw(virtio_blk_io + VIRTIO_REG_QUEUE_NOTIFY, 0);
+}
+
+// Wait until the device has finished at least one request and return the
+// slot of the oldest finished one, or -1 if the device stopped answering
+static int virtio_blk_reap(void) {
+    for (int i = 0; virtio_blk_used->index == virtio_blk_last_used; i++) {
+        if (i == VIRTIO_BLK_TIMEOUT) {
+            // Slots still out can't be trusted again
+            virtio_blk_found = 0;
+            return -1;
+        }
+    }
+    virtio_blk_barrier();
+    
+    uint32_t head = virtio_blk_used->ring[virtio_blk_last_used & (virtio_blk_queue_size - 1)].id;
+    virtio_blk_last_used++;
+    
+    int slot = head / VIRTIO_BLK_CHAIN;
+    virtio_blk_free[virtio_blk_free_count++] = slot;
+    return slot;
+}
+
+static int virtio_blk_valid(const blockdev_request_t* request) {
+    uint32_t sectors = virtio_blk_device.sectors;
+    return request->count > 0 && request->count <= VIRTIO_BLK_MAX_TRANSFER &&
+        request->lba < sectors && request->count <= sectors - request->lba;
+}
+
+// Post requests until `depth` are in flight, notify once for the lot, then
+// refill as completions come back. Requests may finish out of order.
+static int virtio_blk_submit(blockdev_request_t* requests, int count, unsigned int depth) {
+    int next = 0;
+    int completed = 0;
+    int succeeded = 0;
+    unsigned int in_flight = 0;
+    
+    if (depth == 0) {
+        depth = 1;
+    }
+    if (depth > virtio_blk_slots) {
+        depth = virtio_blk_slots;
+    }
+    
+    while (completed < count) {
+        int posted = 0;
+        while (next < count && in_flight < depth) {
+            blockdev_request_t* request = &requests[next++];
+            if (!virtio_blk_found || !virtio_blk_valid(request)) {
+                request->ok = 0;
+                completed++;
+                continue;
+            }
+            
+            int slot = virtio_blk_free[--virtio_blk_free_count];
+            virtio_blk_pending[slot] = request;
+            virtio_blk_post(slot, request->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN,
+                            request->lba, request->count, request->buffer);
+            in_flight++;
+            posted = 1;
+        }
+        if (posted) {
+            virtio_blk_notify();
+        }
+        
+        // Take everything that has finished, waiting for the first one
+        while (in_flight > 0) {
+            int slot = virtio_blk_reap();
+            if (slot < 0) {
+                return succeeded;
+            }
+            
+            blockdev_request_t* request = virtio_blk_pending[slot];
+            request->ok = virtio_blk_status[slot] == VIRTIO_BLK_S_OK;
+            succeeded += request->ok;
+            completed++;
+            in_flight--;
+            
+            if (virtio_blk_used->index == virtio_blk_last_used) {
+                break;
+            }
+        }
+    }
+    return succeeded;
+}
+
+// Large transfers are split into requests that all go out together
+static int virtio_blk_transfer(uint32_t lba, unsigned int count, void* buffer, int write) {
+    blockdev_request_t batch[VIRTIO_BLK_MAX_DEPTH];
+    uint8_t* data = buffer;
+    
+    while (count > 0) {
+        int requests = 0;
+        while (count > 0 && requests < VIRTIO_BLK_MAX_DEPTH) {
+            unsigned int chunk = count < VIRTIO_BLK_MAX_TRANSFER ? count : VIRTIO_BLK_MAX_TRANSFER;
+            blockdev_request_t* request = &batch[requests++];
+            
+            request->lba = lba;
+            request->count = chunk;
+            request->buffer = data;
+            request->write = write;
+            
+            lba += chunk;
+            count -= chunk;
+            data += chunk * BLOCKDEV_SECTOR_SIZE;
+        }
+        
+        if (virtio_blk_submit(batch, requests, VIRTIO_BLK_MAX_DEPTH) != requests) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int virtio_blk_read(uint32_t lba, unsigned int count, void* buffer) {
+    return virtio_blk_transfer(lba, count, buffer, 0);
+}
+
+static int virtio_blk_write(uint32_t lba, unsigned int count, const void* buffer) {
+    return virtio_blk_transfer(lba, count, (void*)buffer, 1);
+}
+
+// Without the flush feature the device doesn't cache writes
+static int virtio_blk_flush(void) {
+    if (!virtio_blk_found) {
+        return 0;
+    }
+    if (!virtio_blk_can_flush) {
+        return 1;
+    }
+    
+    int slot = virtio_blk_free[--virtio_blk_free_count];
+    virtio_blk_post(slot, VIRTIO_BLK_T_FLUSH, 0, 0, NULL);
+    virtio_blk_notify();
+    return virtio_blk_reap() == slot && virtio_blk_status[slot] == VIRTIO_BLK_S_OK;
+}
+
+// Find the device on the PCI bus and set up queue 0. Returns 1 if there is
+// a usable disk.
+int virtio_blk_init(void) {
+    virtio_blk_found = 0;
+    
+    const pci_device_t* dev = pci_find(VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID);
+    if (!dev) {
+        return 0;
+    }
+    uint32_t bar = pci_read32(dev, PCI_BAR0);
+    if (!(bar & PCI_BAR_IO)) {
+        return 0;
+    }
+    virtio_blk_io = bar & PCI_BAR_IO_MASK;
+    pci_enable(dev, PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+    
+    // Reset, then say we have found it and know how to drive it
+    outb(virtio_blk_io + VIRTIO_REG_STATUS, 0);
+    outb(virtio_blk_io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outb(virtio_blk_io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    
+    uint32_t features = inl(virtio_blk_io + VIRTIO_REG_DEVICE_FEATURES);
+    virtio_blk_can_flush = (features & VIRTIO_BLK_F_FLUSH) != 0;
+    outl(virtio_blk_io + VIRTIO_REG_GUEST_FEATURES, features & VIRTIO_BLK_F_FLUSH);
+    
+    // The ring indices wrap at 2^16, so the size has to divide that
+    outw(virtio_blk_io + VIRTIO_REG_QUEUE_SELECT, 0);
+    uint16_t size = inw(virtio_blk_io + VIRTIO_REG_QUEUE_SIZE);
+    if (size < VIRTIO_BLK_CHAIN || (size & (size - 1)) != 0) {
+        outb(virtio_blk_io + VIRTIO_REG_STATUS, VIRTIO_STATUS_FAILED);
+        return 0;
+    }
+    
+    uint32_t used_offset = sizeof(virtq_desc_t) * size + sizeof(virtq_avail_t) + sizeof(uint16_t) * (size + 1);
+    used_offset = (used_offset + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1);
+    uint32_t queue_bytes = used_offset + sizeof(virtq_used_t) + sizeof(virtq_used_elem_t) * size + sizeof(uint16_t);
+    unsigned int pages = (queue_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+    
+    uint8_t* queue = page_alloc(pages);
+    if (!queue) {
+        outb(virtio_blk_io + VIRTIO_REG_STATUS, VIRTIO_STATUS_FAILED);
+        return 0;
+    }
+    memset(queue, 0, pages * PAGE_SIZE);
+    
+    virtio_blk_queue_size = size;
+    virtio_blk_desc = (virtq_desc_t*)queue;
+    virtio_blk_avail = (virtq_avail_t*)(queue + sizeof(virtq_desc_t) * size);
+    virtio_blk_used = (virtq_used_t*)(queue + used_offset);
+    virtio_blk_last_used = 0;
+    
+    // Completions are polled, so the device needn't raise interrupts
+    virtio_blk_avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+    outl(virtio_blk_io + VIRTIO_REG_QUEUE_ADDRESS, (uintptr_t)queue / VIRTQ_ALIGN);
+    
+    virtio_blk_slots = size / VIRTIO_BLK_CHAIN;
+    if (virtio_blk_slots > VIRTIO_BLK_MAX_DEPTH) {
+        virtio_blk_slots = VIRTIO_BLK_MAX_DEPTH;
+    }
+    virtio_blk_free_count = 0;
+    for (unsigned int i = 0; i < virtio_blk_slots; i++) {
+        virtio_blk_free[virtio_blk_free_count++] = i;
+    }
+    
+    // Capacity is a 64-bit sector count; LBAs here are 32 bits
+    uint32_t capacity_low = inl(virtio_blk_io + VIRTIO_REG_CONFIG);
+    uint32_t capacity_high = inl(virtio_blk_io + VIRTIO_REG_CONFIG + 4);
+    
+    outb(virtio_blk_io + VIRTIO_REG_STATUS,
+         VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+    
+    strcpy(virtio_blk_device.name, "Virtio block device");
+    virtio_blk_device.sectors = capacity_high ? 0xFFFFFFFF : capacity_low;
+    virtio_blk_device.max_depth = virtio_blk_slots;
+    virtio_blk_found = virtio_blk_device.sectors > 0;
+    return virtio_blk_found;
+}
+
+blockdev_t virtio_blk_device = {
+    "",
+    0,
+    VIRTIO_BLK_MAX_TRANSFER,
+    1,
+    virtio_blk_read,
+    virtio_blk_write,
+    virtio_blk_flush,
+    virtio_blk_submit,
+};
@@ -0,0 +1,299 @@
+// Host-side benchmark and stress driver for the RAM filesystem.
+//
+// Runs a seeded random mix of create/find/append/rename/delete operations
+// against a fixed working set. Every result is checked against a shadow copy of the
+// expected state. Prints throughput and latency percentiles per operation.
+//
+// Usage: fsbench [operations] [budget MB] [seed]
+#include "filesystem.h"
+#include "string.h"
+#include "types.h"
+
+struct timespec {
+    long tv_sec;
+    long tv_nsec;
+};
+
+#define CLOCK_MONOTONIC 1
+
+int printf(const char* format, ...);
+int clock_gettime(int clock, struct timespec* time);
+void* malloc(unsigned long size);
+void free(void* ptr);
+int memcmp(const void* a, const void* b, unsigned long size);
+void qsort(void* base, unsigned long count, unsigned long size, int (*compare)(const void*, const void*));
+
+#define FSBENCH_DEFAULT_OPS 2000000
+#define FSBENCH_DEFAULT_BUDGET_MB 64
+#define FSBENCH_DIRS 16
+#define FSBENCH_MAX_SLOTS 16384
+#define FSBENCH_MAX_CONTENT 1024
+#define FSBENCH_MAX_APPEND 64
+
+enum { OP_CREATE, OP_FIND, OP_APPEND, OP_RENAME, OP_DELETE, OP_COUNT };
+
+static const char* const op_names[OP_COUNT] = { "create", "find", "append", "rename", "delete" };
+
+typedef struct {
+    unsigned char exists;
+    unsigned char dir;
+    unsigned char renamed;     // Named R<n> instead of F<n>
+    unsigned int size;
+} slot_t;
+
+typedef struct {
+    uint32_t* samples;         // Latency of each call in nanoseconds
+    unsigned long count;
+    uint64_t total_ns;
+} op_stats_t;
+
+static slot_t slots[FSBENCH_MAX_SLOTS];
+static op_stats_t stats[OP_COUNT];
+static char content[FSBENCH_MAX_CONTENT + 1];
+static char append_data[FSBENCH_MAX_APPEND];   // Binary, NULs included
+static unsigned int max_content;
+static uint32_t rng_state;
+static unsigned long failures;
+
+static uint32_t rng_next(void) {
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+static unsigned long parse_number(const char* text, unsigned long fallback) {
+    unsigned long value = 0;
+
+    if (!text || !*text) {
+        return fallback;
+    }
+    for (; *text; text++) {
+        if (*text < '0' || *text > '9') {
+            return fallback;
+        }
+        value = value * 10 + (*text - '0');
+    }
+    return value;
+}
+
+static void dir_name(char* name, int dir) {
+    char number[16];
+    itoa(dir, number, 10);
+    strcpy(name, "\\B");
+    strcat(name, number);
+}
+
+static void slot_name(char* name, int index, int dir, int renamed) {
+    char number[16];
+    dir_name(name, dir);
+    strcat(name, renamed ? "\\R" : "\\F");
+    itoa(index, number, 10);
+    strcat(name, number);
+}
+
+static void record(int op, uint64_t start) {
+    uint64_t elapsed = now_ns() - start;
+    stats[op].samples[stats[op].count++] = (uint32_t)elapsed;
+    stats[op].total_ns += elapsed;
+}
+
+static void check(int ok, const char* what, const char* name) {
+    if (!ok) {
+        if (failures < 10) {
+            printf("MISMATCH: %s %s\n", what, name);
+        }
+        failures++;
+    }
+}
+
+static void run_op(int index) {
+    slot_t* slot = &slots[index];
+    char name[FS_MAX_FILENAME];
+    char new_name[FS_MAX_FILENAME];
+    uint32_t roll = rng_next() % 100;
+    uint64_t start;
+    int result;
+
+    slot_name(name, index, slot->dir, slot->renamed);
+
+    if (!slot->exists) {
+        // Absent slots get created most of the time, otherwise probed for a miss
+        if (roll < 70) {
+            unsigned int length = rng_next() % (FSBENCH_MAX_CONTENT + 1);
+            char saved = content[length];
+            content[length] = '\0';
+            start = now_ns();
+            result = fs_create_file(name, content);
+            record(OP_CREATE, start);
+            content[length] = saved;
+            check(result, "create", name);
+            slot->exists = result != 0;
+            slot->size = length < max_content ? length : max_content;
+        } else {
+            start = now_ns();
+            result = fs_find(name) != 0;
+            record(OP_FIND, start);
+            check(!result, "find (miss)", name);
+        }
+        return;
+    }
+
+    if (roll < 50) {
+        start = now_ns();
+        result = fs_find(name) != 0;
+        record(OP_FIND, start);
+        check(result, "find (hit)", name);
+    } else if (roll < 60) {
+        // Files stay within max_content so the working set still fits
+        unsigned int length = rng_next() % (FSBENCH_MAX_APPEND + 1);
+        if (slot->size + length > max_content) {
+            length = max_content - slot->size;
+        }
+        start = now_ns();
+        int handle = fs_open(name, FS_OPEN_WRITE | FS_OPEN_APPEND);
+        result = handle != FS_NO_HANDLE && fs_write(handle, append_data, length) == length;
+        fs_close(handle);
+        record(OP_APPEND, start);
+        check(result, "append", name);
+        
+        // Read the tail back through a handle
+        char tail[FSBENCH_MAX_APPEND];
+        slot->size += length;
+        handle = fs_open(name, FS_OPEN_READ);
+        result = fs_seek(handle, -(int)length, FS_SEEK_END) && fs_tell(handle) == slot->size - length &&
+                 fs_read(handle, tail, sizeof(tail)) == length && memcmp(tail, append_data, length) == 0;
+        fs_close(handle);
+        check(result, "append (read back)", name);
+    } else if (roll < 80) {
+        int dir = rng_next() % FSBENCH_DIRS;
+        slot_name(new_name, index, dir, !slot->renamed);
+        start = now_ns();
+        result = fs_rename(name, new_name);
+        record(OP_RENAME, start);
+        check(result, "rename", name);
+        if (result) {
+            slot->dir = dir;
+            slot->renamed = !slot->renamed;
+        }
+    } else {
+        start = now_ns();
+        result = fs_delete(name);
+        record(OP_DELETE, start);
+        check(result, "delete", name);
+        slot->exists = !result;
+    }
+}
+
+static int compare_samples(const void* a, const void* b) {
+    uint32_t left = *(const uint32_t*)a;
+    uint32_t right = *(const uint32_t*)b;
+    return (left > right) - (left < right);
+}
+
+static uint32_t percentile(const op_stats_t* op, unsigned int per_mille) {
+    unsigned long rank = op->count * per_mille / 1000;
+    if (rank >= op->count) {
+        rank = op->count - 1;
+    }
+    return op->samples[rank];
+}
+
+static void report(void) {
+    printf("%-8s %10s %12s %8s %8s %8s %8s %8s\n",
+           "op", "count", "op/s", "p50", "p90", "p99", "p99.9", "max");
+
+    for (int op = 0; op < OP_COUNT; op++) {
+        op_stats_t* entry = &stats[op];
+        if (entry->count == 0) {
+            continue;
+        }
+
+        qsort(entry->samples, entry->count, sizeof(uint32_t), compare_samples);
+        double rate = entry->total_ns ? entry->count * 1e9 / entry->total_ns : 0;
+
+        printf("%-8s %10lu %12.0f %8u %8u %8u %8u %8u\n", op_names[op], entry->count, rate,
+               percentile(entry, 500), percentile(entry, 900), percentile(entry, 990),
+               percentile(entry, 999), entry->samples[entry->count - 1]);
+    }
+    printf("(latencies in ns)\n");
+}
+
+int main(int argc, char** argv) {
+    unsigned long operations = parse_number(argc > 1 ? argv[1] : NULL, FSBENCH_DEFAULT_OPS);
+    unsigned long budget_mb = parse_number(argc > 2 ? argv[2] : NULL, FSBENCH_DEFAULT_BUDGET_MB);
+    rng_state = (uint32_t)parse_number(argc > 3 ? argv[3] : NULL, 1);
+    if (rng_state == 0) {
+        rng_state = 1;
+    }
+
+    // Every x86-64 CPU has SSE2
+    string_set_sse2(1);
+    fs_init(budget_mb * 1024 * 1024);
+
+    char name[FS_MAX_FILENAME];
+    for (int dir = 0; dir < FSBENCH_DIRS; dir++) {
+        dir_name(name, dir);
+        fs_create_directory(name);
+    }
+
+    int free_blocks = fs_free_blocks();
+    int slot_count = fs_max_files - fs_file_count;
+    if (slot_count > FSBENCH_MAX_SLOTS) {
+        slot_count = FSBENCH_MAX_SLOTS;
+    }
+
+    // Keep content small enough that the working set always fits
+    max_content = (free_blocks / slot_count) * FS_BLOCK_SIZE;
+    if (max_content > FSBENCH_MAX_CONTENT) {
+        max_content = FSBENCH_MAX_CONTENT;
+    }
+    for (unsigned int i = 0; i < FSBENCH_MAX_CONTENT; i++) {
+        content[i] = i < max_content ? 'a' + i % 26 : '\0';
+    }
+    for (int i = 0; i < FSBENCH_MAX_APPEND; i++) {
+        append_data[i] = (char)(i * 37);
+    }
+
+    for (int op = 0; op < OP_COUNT; op++) {
+        stats[op].samples = malloc(operations * sizeof(uint32_t));
+        if (!stats[op].samples) {
+            printf("out of memory for %lu samples\n", operations);
+            return 1;
+        }
+    }
+
+    printf("fsbench: %lu operations, %d entries, %d blocks, %d slots, seed %u\n",
+           operations, fs_max_files, fs_max_blocks, slot_count, rng_state);
+
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < operations; i++) {
+        run_op(rng_next() % slot_count);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    // Tear everything down and make sure no blocks leaked
+    for (int i = 0; i < slot_count; i++) {
+        if (slots[i].exists) {
+            slot_name(name, i, slots[i].dir, slots[i].renamed);
+            check(fs_delete(name), "delete (cleanup)", name);
+        }
+    }
+    check(fs_free_blocks() == free_blocks, "free block count", "after cleanup");
+
+    report();
+    printf("total: %.3f s, %.0f op/s, %lu mismatch(es)\n",
+           elapsed / 1e9, operations * 1e9 / (elapsed ? elapsed : 1), failures);
+
+    for (int op = 0; op < OP_COUNT; op++) {
+        free(stats[op].samples);
+    }
+    return failures ? 1 : 0;
+}
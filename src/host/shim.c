@@ -0,0 +1,21 @@
+// Kernel services the filesystem code needs when it's built for the host.
+// Only kernel headers are included; the libc functions are declared by hand
+// because the kernel's own string.h and types.h shadow the system ones.
+#include "heap.h"
+#include "types.h"
+
+void* malloc(unsigned long size);
+void* calloc(unsigned long count, unsigned long size);
+void free(void* ptr);
+
+void* kmalloc(size_t size) {
+    return size ? malloc(size) : NULL;
+}
+
+void* kzalloc(size_t size) {
+    return size ? calloc(1, size) : NULL;
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
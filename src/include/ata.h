@@ -0,0 +1,51 @@
+#ifndef ATA_H
+#define ATA_H
+
+#include "blockdev.h"
+#include "types.h"
+
+// Primary IDE channel, master drive (QEMU -hda), polled PIO with LBA28
+#define ATA_PRIMARY_IO 0x1F0
+#define ATA_PRIMARY_CONTROL 0x3F6
+
+// Register offsets from the I/O base
+#define ATA_REG_DATA 0
+#define ATA_REG_ERROR 1
+#define ATA_REG_SECTOR_COUNT 2
+#define ATA_REG_LBA_LOW 3
+#define ATA_REG_LBA_MID 4
+#define ATA_REG_LBA_HIGH 5
+#define ATA_REG_DRIVE 6
+#define ATA_REG_STATUS 7
+#define ATA_REG_COMMAND 7
+
+#define ATA_STATUS_ERR 0x01
+#define ATA_STATUS_DRQ 0x08
+#define ATA_STATUS_DF 0x20
+#define ATA_STATUS_BSY 0x80
+
+#define ATA_CMD_READ_SECTORS 0x20
+#define ATA_CMD_WRITE_SECTORS 0x30
+#define ATA_CMD_CACHE_FLUSH 0xE7
+#define ATA_CMD_IDENTIFY 0xEC
+
+#define ATA_DRIVE_MASTER_LBA 0xE0
+#define ATA_CONTROL_NIEN 0x02      // No IRQ 14, the driver polls
+
+#define ATA_SECTOR_SIZE BLOCKDEV_SECTOR_SIZE
+#define ATA_MAX_TRANSFER 256       // Sectors per command; 0 in the count register
+#define ATA_TIMEOUT 1000000        // Status polls before a command gives up
+#define ATA_MODEL_LENGTH BLOCKDEV_NAME_LENGTH
+
+int ata_init(void);
+int ata_present(void);
+uint32_t ata_sector_count(void);
+const char* ata_model(void);
+int ata_read_sectors(uint32_t lba, unsigned int count, void* buffer);
+int ata_write_sectors(uint32_t lba, unsigned int count, const void* buffer);
+int ata_flush(void);
+
+// Filled in by ata_init()
+extern blockdev_t ata_device;
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "blockdev.h"
+#include "types.h"
+#include "timer.h"
+
+// Write-back LRU cache of disk sectors in front of a block device
+#define BCACHE_SECTORS 512             // 256 KiB of sector data
+#define BCACHE_HASH_SIZE 1024          // LBA index buckets, a power of two
+#define BCACHE_READAHEAD 64            // Sectors fetched per miss in a sequential run
+#define BCACHE_FLUSH_TICKS TIMER_HZ    // Dirty data waits at most this long for an idle flush
+
+typedef struct {
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int readahead;        // Sectors read beyond what was asked for
+    unsigned int device_reads;     // Commands sent to the drive
+    unsigned int device_writes;
+    unsigned int sectors_read;
+    unsigned int sectors_written;
+    unsigned int dirty;            // Sectors waiting to be written back
+} bcache_stats_t;
+
+int bcache_init(blockdev_t* device);
+blockdev_t* bcache_get_device(void);
+int bcache_read(uint32_t lba, unsigned int count, void* buffer);
+int bcache_write(uint32_t lba, unsigned int count, const void* buffer);
+int bcache_flush(void);
+void bcache_idle(void);
+int bcache_invalidate(void);
+void bcache_get_stats(bcache_stats_t* stats);
+void bcache_reset_stats(void);
+
+#endif
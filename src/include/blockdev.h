@@ -0,0 +1,32 @@
+#ifndef BLOCKDEV_H
+#define BLOCKDEV_H
+
+#include "types.h"
+
+// A disk the sector cache and filesystems can sit on, whichever driver
+// found it. Transfers are in whole sectors.
+#define BLOCKDEV_SECTOR_SIZE 512
+#define BLOCKDEV_NAME_LENGTH 40
+
+typedef struct {
+    uint32_t lba;
+    unsigned int count;            // At most the device's max_transfer
+    void* buffer;
+    int write;
+    int ok;                        // Set when the request completes
+} blockdev_request_t;
+
+typedef struct {
+    char name[BLOCKDEV_NAME_LENGTH + 1];
+    uint32_t sectors;
+    unsigned int max_transfer;     // Sectors per request
+    unsigned int max_depth;        // Requests the device can work on at once
+    int (*read)(uint32_t lba, unsigned int count, void* buffer);
+    int (*write)(uint32_t lba, unsigned int count, const void* buffer);
+    int (*flush)(void);
+    // Run a batch keeping up to `depth` requests in flight. Returns how
+    // many requests succeeded.
+    int (*submit)(blockdev_request_t* requests, int count, unsigned int depth);
+} blockdev_t;
+
+#endif
@@ -0,0 +1,35 @@
+// Shell command table, expanded with different definitions of COMMAND():
+//
+//     COMMAND(name, alias, min_args, max_args, flags, handler, usage, help)
+//
+// Names are lowercase; alias is NULL when there is none. The handler takes
+// max_args `const char*` arguments, with missing ones passed as "". RAW
+// commands get everything after the command word as their one argument.
+// tools/gen_command_hash.c builds the dispatch hash from this list, and HELP
+// prints it in this order.
+
+COMMAND("bench",        NULL,       0,  0,  0,                 cmd_bench,         "BENCH",                       "Runs string, filesystem and console microbenchmarks")
+COMMAND("cd",           "chdir",    0,  1,  COMMAND_DIR_ARG,   cmd_cd,            "CD [directory]",              "Changes the current directory")
+COMMAND("cls",          "clear",    0,  0,  0,                 vga_clear_screen,  "CLS",                         "Clears the screen")
+COMMAND("colortest",    NULL,       0,  0,  0,                 cmd_colortest,     "COLORTEST",                   "Displays a color test")
+COMMAND("copy",         "cp",       2,  2,  0,                 cmd_copy,          "COPY <source> <destination>", "Copies a file")
+COMMAND("del",          "delete",   1,  1,  COMMAND_FILE_ARG,  cmd_del,           "DEL <filename>",              "Deletes a file")
+COMMAND("dir",          "ls",       0,  1,  0,                 cmd_dir_path,      "DIR [directory]",             "Lists files and directories")
+COMMAND("diskbench",    NULL,       0,  0,  0,                 cmd_diskbench,     "DISKBENCH",                   "Measures disk and sector cache throughput")
+COMMAND("echo",         NULL,       0,  1,  COMMAND_RAW,       cmd_echo,          "ECHO [message]",              "Displays a message")
+COMMAND("findbench",    NULL,       0,  0,  0,                 cmd_findbench,     "FINDBENCH",                   "Times hashed and linear path lookups")
+COMMAND("help",         NULL,       0,  0,  0,                 cmd_help,          "HELP",                        "Shows this help message")
+COMMAND("iobench",      NULL,       0,  0,  0,                 cmd_iobench,       "IOBENCH",                     "Measures disk MB/s and requests/s at several queue depths")
+COMMAND("load",         NULL,       0,  0,  0,                 cmd_load,          "LOAD",                        "Replaces the RAM disk with the copy saved on the disk")
+COMMAND("mem",          NULL,       0,  0,  0,                 cmd_mem,           "MEM",                         "Shows memory usage")
+COMMAND("mkdir",        "md",       1,  1,  COMMAND_DIR_ARG,   cmd_mkdir,         "MKDIR <dirname>",             "Creates a directory")
+COMMAND("move",         "mv",       2,  2,  0,                 cmd_move,          "MOVE <source> <destination>", "Moves a file or directory")
+COMMAND("ren",          "rename",   2,  2,  0,                 cmd_rename,        "REN <oldname> <newname>",     "Renames a file or directory")
+COMMAND("rm",           NULL,       1,  1,  0,                 cmd_rm,            "RM <filename>",               "Removes a file (alias for DEL)")
+COMMAND("rmdir",        "rd",       1,  1,  0,                 cmd_rmdir,         "RMDIR <dirname>",             "Removes a directory")
+COMMAND("save",         NULL,       0,  0,  0,                 cmd_save,          "SAVE",                        "Saves the RAM disk to the end of the disk")
+COMMAND("scrollbench",  NULL,       0,  0,  0,                 cmd_scrollbench,   "SCROLLBENCH",                 "Compares copy and hardware scrolling")
+COMMAND("time",         NULL,       1,  1,  COMMAND_RAW,       cmd_time,          "TIME <command>",              "Runs a command and shows how long it took")
+COMMAND("touch",        NULL,       1,  1,  0,                 cmd_touch,         "TOUCH <filename>",            "Creates an empty file")
+COMMAND("type",         "cat",      1,  1,  COMMAND_FILE_ARG,  cmd_type,          "TYPE <filename>",             "Displays the contents of a file")
+COMMAND("ver",          "version",  0,  0,  0,                 cmd_version,       "VER",                         "Shows version information")
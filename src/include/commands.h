@@ -1,6 +1,7 @@
 #ifndef COMMANDS_H
 #define COMMANDS_H
 
+void resolve_path(const char* path, char* full_path);
 void cmd_version(void);
 void cmd_help(void);
 void cmd_dir(void);
@@ -14,6 +15,15 @@ void cmd_mkdir(const char* dirname);
 void cmd_rmdir(const char* dirname);
 void cmd_cd(const char* dirname);
 void cmd_colortest(void);
+void cmd_scrollbench(void);
+void cmd_findbench(void);
+void cmd_mem(void);
+void cmd_bench(void);
+void cmd_diskbench(void);
+void cmd_iobench(void);
+void cmd_save(void);
+void cmd_load(void);
+void cmd_time(const char* line);
 void cmd_echo(const char* text);
 void cmd_touch(const char* filename);
 void cmd_rm(const char* filename);
@@ -0,0 +1,22 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "types.h"
+
+// CPUID leaf 1 EDX feature bits
+#define CPU_FEATURE_SSE (1u << 25)
+#define CPU_FEATURE_SSE2 (1u << 26)
+
+#define CPU_CR0_MP (1u << 1)       // Monitor coprocessor
+#define CPU_CR0_EM (1u << 2)       // x87 emulation, must be clear for SSE
+#define CPU_CR4_OSFXSR (1u << 9)   // OS supports FXSAVE and SSE
+#define CPU_CR4_OSXMMEXCPT (1u << 10)
+
+void cpu_init(void);
+int cpu_has_feature(uint32_t feature);
+
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile("cpuid" : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx) : "a" (leaf), "c" (0));
+}
+
+#endif
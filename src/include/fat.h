@@ -0,0 +1,78 @@
+#ifndef FAT_H
+#define FAT_H
+
+#include "types.h"
+
+// FAT12/16 volume on the ATA disk, found either at LBA 0 or in the first
+// FAT partition of an MBR
+#define FAT_SECTOR_SIZE 512
+#define FAT_DIRENTS_PER_SECTOR (FAT_SECTOR_SIZE / sizeof(fat_dirent_t))
+#define FAT_NAME_LENGTH 11         // 8.3 name, space padded, no dot
+
+#define FAT_ATTR_VOLUME_ID 0x08
+#define FAT_ATTR_DIRECTORY 0x10
+#define FAT_ATTR_ARCHIVE 0x20
+#define FAT_ATTR_LONG_NAME 0x0F
+
+// First byte of a directory entry's name
+#define FAT_ENTRY_END 0x00
+#define FAT_ENTRY_DELETED 0xE5
+#define FAT_ENTRY_KANJI_E5 0x05    // Stands for a real 0xE5 first character
+
+// Cluster counts decide the FAT width
+#define FAT12_MAX_CLUSTERS 4084
+#define FAT16_MAX_CLUSTERS 65524
+#define FAT_FIRST_CLUSTER 2
+#define FAT12_END 0xFFF
+#define FAT16_END 0xFFFF
+#define FAT12_END_MIN 0xFF8
+#define FAT16_END_MIN 0xFFF8
+
+#define FAT_MBR_SIGNATURE 0xAA55
+#define FAT_MBR_PARTITIONS 0x1BE
+
+typedef struct {
+    uint8_t jump[3];
+    char oem[8];
+    uint16_t bytes_per_sector;
+    uint8_t sectors_per_cluster;
+    uint16_t reserved_sectors;
+    uint8_t fat_count;
+    uint16_t root_entries;
+    uint16_t total_sectors_16;
+    uint8_t media;
+    uint16_t sectors_per_fat;
+    uint16_t sectors_per_track;
+    uint16_t heads;
+    uint32_t hidden_sectors;
+    uint32_t total_sectors_32;
+} __attribute__((packed)) fat_bpb_t;
+
+typedef struct {
+    uint8_t name[FAT_NAME_LENGTH];
+    uint8_t attributes;
+    uint8_t reserved;
+    uint8_t create_tenths;
+    uint16_t create_time;
+    uint16_t create_date;
+    uint16_t access_date;
+    uint16_t cluster_high;         // Always 0 on FAT12/16
+    uint16_t write_time;
+    uint16_t write_date;
+    uint16_t cluster_low;
+    uint32_t size;
+} __attribute__((packed)) fat_dirent_t;
+
+typedef struct {
+    uint8_t status;
+    uint8_t chs_first[3];
+    uint8_t type;
+    uint8_t chs_last[3];
+    uint32_t lba_first;
+    uint32_t sectors;
+} __attribute__((packed)) fat_partition_t;
+
+int fat_mount(const char* path);
+uint32_t fat_volume_end(void);
+
+#endif
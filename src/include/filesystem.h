@@ -1,26 +1,130 @@
 #ifndef FILESYSTEM_H
 #define FILESYSTEM_H
 
-#define FS_MAX_FILES 64
+#include "types.h"
+
 #define FS_MAX_FILENAME 32
-#define FS_MAX_CONTENT 4096 
+
+// File data lives in a shared pool of fixed-size blocks
+#define FS_BLOCK_SIZE 256
+#define FS_NO_BLOCK -1
+#define FS_NO_ENTRY -1
+
+// Table sizes are picked at boot from the memory handed to fs_init()
+#define FS_MIN_FILES 64
+#define FS_LIMIT_FILES 65536
+#define FS_BLOCKS_PER_FILE 16
+
+// Per-directory sorted child index for prefix lookups, grown by doubling
+#define FS_SORTED_MIN_CAPACITY 8
+
+// Open-addressing path index, a power of two at least twice fs_max_files
+#define FS_HASH_EMPTY -1
+#define FS_HASH_DELETED -2
+
+// fs_open() modes
+#define FS_OPEN_READ 0x01
+#define FS_OPEN_WRITE 0x02
+#define FS_OPEN_CREATE 0x04        // Create an empty file if there is none
+#define FS_OPEN_APPEND 0x08        // Every write goes to the end of the file
+
+#define FS_SEEK_SET 0
+#define FS_SEEK_CUR 1
+#define FS_SEEK_END 2
+
+// Open file handles are small integers into a fixed table
+#define FS_MAX_HANDLES 16
+#define FS_NO_HANDLE -1
+
+// Other volumes hang off a directory of the RAM filesystem; 0 is the RAM disk
+#define FS_VOLUME_RAM 0
+#define FS_MAX_VOLUMES 4
 
 // File type flags
+#define FS_FREE 0x00               // Unused table slot
 #define FS_FILE 0x01
 #define FS_DIRECTORY 0x02
 
 typedef struct {
     char name[FS_MAX_FILENAME];
     unsigned char type;        // File or directory
+    unsigned char volume;      // FS_VOLUME_RAM or a mounted volume
+    unsigned char loaded;      // Directories: children are in the table
     unsigned int size;         // Size of file content
-    char content[FS_MAX_CONTENT];
+    int first_block;           // Head of the data block chain, FS_NO_BLOCK if empty
+    int parent;                // Containing directory, FS_NO_ENTRY for the root
+    int first_child;           // Directories: child list in creation order
+    int last_child;
+    int prev_sibling;          // Links within the parent's child list
+    int next_sibling;
+    int child_count;
+    int* sorted_children;      // Directories: child indices ordered by basename,
+    int sorted_capacity;       // rebuilt on demand after the directory changes
+    int sorted_valid;
+    uint32_t location;         // Mounted volumes: where the data starts
+    uint32_t record;           // Mounted volumes: where the entry itself is stored
 } fs_file_t;
 
-extern fs_file_t fs_files[FS_MAX_FILES];
-extern int fs_file_count;
+// Hooks for a mounted volume. Its entries are read into the table one
+// directory at a time, the first time a path or listing reaches them. A
+// NULL hook makes that operation fail, so read-only volumes leave the
+// writing ones out. Metadata hooks run before the table changes and can
+// veto it.
+typedef struct {
+    int (*load)(fs_file_t* dir);
+    unsigned int (*read)(const fs_file_t* file, unsigned int offset, char* buffer, unsigned int length);
+    unsigned int (*write)(fs_file_t* file, unsigned int offset, const char* data, unsigned int length);
+    int (*create)(fs_file_t* entry);
+    int (*remove)(fs_file_t* entry);
+    int (*rename)(fs_file_t* entry, fs_file_t* new_parent, const char* new_name);
+    // Optional: where the bytes from `offset` on sit in memory, with the
+    // length of that run, for volumes that keep file data there
+    const char* (*map)(const fs_file_t* file, unsigned int offset, unsigned int* length);
+} fs_volume_t;
+
+// A place in a file's block chain, so sequential access doesn't walk it
+// from the head every time
+typedef struct {
+    int block;                 // FS_NO_BLOCK when nothing is cached
+    unsigned int start;        // File offset where `block` begins
+} fs_cursor_t;
+
+// Read-only view of a file, handed out as contiguous spans of the stored
+// bytes: runs of adjacent blocks on the RAM disk, the whole file for
+// volumes with a map hook. Other volumes are read into `buffer` a piece
+// at a time. Spans stay valid until the file is next changed.
+typedef struct {
+    const fs_file_t* file;
+    unsigned int offset;       // Where the next span starts
+    fs_cursor_t cursor;
+    char buffer[FS_BLOCK_SIZE];
+} fs_map_t;
+
+// Counts describing a snapshot of the RAM disk (see utils/snapshot.c).
+// Entries of mounted volumes are left out and the used blocks are packed
+// from 0, so restoring is a few bulk reads straight into the tables.
+typedef struct {
+    int32_t slot_count;
+    int32_t file_count;
+    int32_t free_entry_head;
+    int32_t block_count;
+    int32_t hash_size;
+    int32_t hash_tombstones;
+} fs_snapshot_info_t;
+
+// Moves the next `length` bytes of a snapshot payload to or from storage.
+// Reading into NULL skips them. Returns 0 on failure.
+typedef int (*fs_snapshot_io_t)(void* data, unsigned int length);
+
+extern fs_file_t* fs_files;
+extern int fs_file_count;    // Live entries
+extern int fs_slot_count;    // Table slots ever handed out; entries never move
+extern int fs_max_files;
+extern int fs_max_blocks;
 extern char fs_current_dir[FS_MAX_FILENAME];
 
-void fs_init(void);
+void fs_init(unsigned int budget);
+void fs_capacity_for_memory(unsigned int budget, int* max_files, int* max_blocks);
 int fs_create_file(const char* name, const char* content);
 int fs_create_directory(const char* name);
 int fs_delete(const char* name);
@@ -28,7 +132,34 @@ int fs_rename(const char* oldname, const char* newname);
 int fs_copy(const char* source, const char* dest);
 int fs_move(const char* source, const char* dest);
 fs_file_t* fs_find(const char* name);
+fs_file_t* fs_first_child(fs_file_t* dir);
+fs_file_t* fs_next_child(const fs_file_t* entry);
+fs_file_t* fs_parent(const fs_file_t* entry);
+const char* fs_basename(const fs_file_t* entry);
+int fs_prefix_range(fs_file_t* dir, const char* prefix, int* first);
+fs_file_t* fs_sorted_child(const fs_file_t* dir, int position);
+unsigned int fs_read_data(const fs_file_t* file, unsigned int offset, char* buffer, unsigned int length);
+unsigned int fs_write_data(fs_file_t* file, unsigned int offset, const char* data, unsigned int length);
+int fs_open(const char* name, int mode);
+unsigned int fs_read(int handle, void* buffer, unsigned int length);
+unsigned int fs_write(int handle, const void* data, unsigned int length);
+int fs_seek(int handle, int offset, int whence);
+unsigned int fs_tell(int handle);
+int fs_close(int handle);
+int fs_map(const char* name, unsigned int* length, fs_map_t* map);
+void fs_map_file(const fs_file_t* file, fs_map_t* map);
+unsigned int fs_map_next(fs_map_t* map, const char** span);
+int fs_free_blocks(void);
 void fs_list_directory(void);
 void get_parent_dir(const char* path, char* parent);
+int fs_mount(const char* path, const fs_volume_t* volume, uint32_t location);
+fs_file_t* fs_add_loaded(fs_file_t* dir, const char* name, unsigned char type, unsigned int size,
+                         uint32_t location, uint32_t record);
+void fs_reset(void);
+int fs_snapshot_prepare(fs_snapshot_info_t* info);
+uint32_t fs_snapshot_size(const fs_snapshot_info_t* info);
+int fs_snapshot_save(fs_snapshot_info_t* info, fs_snapshot_io_t write);
+int fs_snapshot_fits(const fs_snapshot_info_t* info);
+int fs_snapshot_restore(const fs_snapshot_info_t* info, fs_snapshot_io_t read);
 
 #endif
\ No newline at end of file
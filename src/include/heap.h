@@ -0,0 +1,39 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "types.h"
+#include "pmm.h"
+
+// Small objects come from per-size-class slabs of one page each:
+// 16, 32, 64, ..., 1024 bytes. Anything bigger gets whole pages.
+#define KHEAP_MIN_CLASS_SHIFT 4
+#define KHEAP_CLASS_COUNT 7
+#define KHEAP_MAX_SLAB_OBJECT (1 << (KHEAP_MIN_CLASS_SHIFT + KHEAP_CLASS_COUNT - 1))
+
+typedef struct {
+    unsigned int object_size;
+    unsigned int in_use;       // Live objects
+    unsigned int peak;         // High-water mark of live objects
+    unsigned int slabs;        // Pages currently owned by this class
+    unsigned int capacity;     // Object slots across those pages
+} kheap_class_stats_t;
+
+typedef struct {
+    unsigned int total_pages;  // Usable physical memory
+    unsigned int free_pages;
+    unsigned int used_pages;   // Pages held by the heap
+    unsigned int peak_pages;
+    unsigned int largest_free_run;
+    unsigned int large_allocations;
+} kheap_page_stats_t;
+
+void kheap_init(void);
+void* kmalloc(size_t size);
+void* kzalloc(size_t size);
+void kfree(void* ptr);
+void* page_alloc(unsigned int count);
+void page_free(void* page, unsigned int count);
+void kheap_get_class_stats(int index, kheap_class_stats_t* stats);
+void kheap_get_page_stats(kheap_page_stats_t* stats);
+
+#endif
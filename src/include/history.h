@@ -0,0 +1,16 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+// Command lines are packed back to back into one circular arena; the oldest
+// are dropped as new ones overwrite them. Entries are counted by age, 0
+// being the most recent.
+#define HISTORY_ARENA_SIZE 32768
+#define HISTORY_MAX_ENTRIES 4096   // Must be a power of two
+
+void history_init(void);
+void history_add(const char* command);
+int history_length(void);
+const char* history_entry(int age);
+int history_find(const char* pattern, int age);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef IDT_H
+#define IDT_H
+
+#include "types.h"
+
+#define IDT_ENTRIES 256
+
+// Interrupt gate, present, ring 0
+#define IDT_GATE_INTERRUPT 0x8E
+
+// 8259 PIC ports and commands
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA 0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA 0xA1
+#define PIC_EOI 0x20
+
+// Hardware IRQs are remapped above the CPU exception vectors
+#define IRQ_BASE_VECTOR 0x20
+#define IRQ_COUNT 16
+
+#define IRQ_TIMER 0
+#define IRQ_KEYBOARD 1
+#define IRQ_CASCADE 2
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type_attr;
+    uint16_t offset_high;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_pointer_t;
+
+typedef void (*irq_handler_t)(void);
+
+void idt_init(void);
+void irq_install_handler(int irq, irq_handler_t handler);
+void irq_dispatch(int irq);
+
+static inline void interrupts_enable(void) {
+    __asm__ volatile("sti");
+}
+
+static inline void interrupts_disable(void) {
+    __asm__ volatile("cli");
+}
+
+// Atomically re-enable interrupts and sleep until the next one arrives
+static inline void interrupts_wait(void) {
+    __asm__ volatile("sti; hlt");
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef INITRD_H
+#define INITRD_H
+
+#include "multiboot.h"
+#include "types.h"
+
+// A ustar archive loaded by GRUB as a multiboot module whose command line
+// mentions "initrd", mounted read-only. File data is read in place.
+#define INITRD_MOUNT_PATH "\\INITRD"
+#define INITRD_MODULE_TAG "initrd"
+
+#define TAR_BLOCK_SIZE 512
+#define TAR_MAGIC "ustar"
+#define TAR_TYPE_FILE '0'
+#define TAR_TYPE_FILE_OLD '\0'
+#define TAR_TYPE_DIRECTORY '5'
+#define TAR_PATH_MAX (155 + 1 + 100 + 1)   // prefix + '/' + name + NUL
+
+typedef struct {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];                 // Octal, like the other numbers
+    char mtime[12];
+    char checksum[8];
+    char type;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];              // Leading directories of long paths
+    char padding[12];
+} __attribute__((packed)) tar_header_t;
+
+int initrd_init(uint32_t magic, multiboot_info_t* mbi);
+
+#endif
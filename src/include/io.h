@@ -3,6 +3,12 @@
 
 static inline unsigned char inb(unsigned short port);
 static inline void outb(unsigned short port, unsigned char data);
+static inline unsigned short inw(unsigned short port);
+static inline void outw(unsigned short port, unsigned short data);
+static inline unsigned int inl(unsigned short port);
+static inline void outl(unsigned short port, unsigned int data);
+static inline void insw(unsigned short port, void* buffer, unsigned int count);
+static inline unsigned long long rdtsc(void);
 
 static inline unsigned char inb(unsigned short port) {
     unsigned char result;
@@ -14,4 +20,36 @@ static inline void outb(unsigned short port, unsigned char data) {
     __asm__ volatile("outb %0, %1" : : "a" (data), "Nd" (port));
 }
 
+static inline unsigned short inw(unsigned short port) {
+    unsigned short result;
+    __asm__ volatile("inw %1, %0" : "=a" (result) : "Nd" (port));
+    return result;
+}
+
+static inline void outw(unsigned short port, unsigned short data) {
+    __asm__ volatile("outw %0, %1" : : "a" (data), "Nd" (port));
+}
+
+static inline unsigned int inl(unsigned short port) {
+    unsigned int result;
+    __asm__ volatile("inl %1, %0" : "=a" (result) : "Nd" (port));
+    return result;
+}
+
+static inline void outl(unsigned short port, unsigned int data) {
+    __asm__ volatile("outl %0, %1" : : "a" (data), "Nd" (port));
+}
+
+// Read `count` 16-bit words from `port` into `buffer`
+static inline void insw(unsigned short port, void* buffer, unsigned int count) {
+    __asm__ volatile("rep insw" : "+D" (buffer), "+c" (count) : "d" (port) : "memory");
+}
+
+// Read the CPU timestamp counter
+static inline unsigned long long rdtsc(void) {
+    unsigned int low, high;
+    __asm__ volatile("rdtsc" : "=a" (low), "=d" (high));
+    return ((unsigned long long)high << 32) | low;
+}
+
 #endif
\ No newline at end of file
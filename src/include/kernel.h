@@ -1,19 +1,21 @@
 #ifndef KERNEL_H
 #define KERNEL_H
 
-#define COMMAND_HISTORY_SIZE 10
+#include "types.h"
+#include "multiboot.h"
+
 #define MAX_COMMAND_LENGTH 256
+#define TAB_LIST_MAX 100           // Candidates shown by a second Tab
 
 extern char input_buffer[MAX_COMMAND_LENGTH];
 extern int buffer_position;
-extern char command_history[COMMAND_HISTORY_SIZE][MAX_COMMAND_LENGTH];
-extern int history_count;
 extern int history_position;
 
-void kernel_main(void);
+void kernel_main(uint32_t magic, multiboot_info_t* mbi);
 void process_command(void);
-void add_to_history(const char* command);
 void navigate_history(int direction);
+void reverse_search_start(void);
+int reverse_search_key(char key);
 void handle_tab_completion(void);
 
 #endif
\ No newline at end of file
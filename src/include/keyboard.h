@@ -4,10 +4,14 @@
 #define KEYBOARD_DATA_PORT 0x60
 #define KEYBOARD_STATUS_PORT 0x64
 
-#define KEY_UP      0x48
-#define KEY_DOWN    0x50
-#define KEY_LEFT    0x4B
-#define KEY_RIGHT   0x4D
+// Scancode ring buffer size, must be a power of two
+#define KEYBOARD_BUFFER_SIZE 128
+
+// Key codes for non-printing keys, kept clear of printable ASCII
+#define KEY_UP      0x11
+#define KEY_DOWN    0x12
+#define KEY_LEFT    0x13
+#define KEY_RIGHT   0x14
 #define KEY_TAB     0x0F
 #define KEY_ESCAPE  0x01
 
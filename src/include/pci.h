@@ -0,0 +1,52 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include "types.h"
+
+// Configuration space through the legacy 0xCF8/0xCFC mechanism
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+#define PCI_ENABLE 0x80000000
+
+#define PCI_MAX_BUSES 256
+#define PCI_MAX_DEVICES 32
+#define PCI_MAX_FUNCTIONS 8
+#define PCI_MAX_FOUND 32           // Functions remembered by pci_init()
+
+// Configuration space offsets
+#define PCI_VENDOR_ID 0x00
+#define PCI_DEVICE_ID 0x02
+#define PCI_COMMAND 0x04
+#define PCI_SUBCLASS 0x0A
+#define PCI_CLASS 0x0B
+#define PCI_HEADER_TYPE 0x0E
+#define PCI_BAR0 0x10
+
+#define PCI_VENDOR_NONE 0xFFFF
+#define PCI_HEADER_MULTIFUNCTION 0x80
+#define PCI_COMMAND_IO 0x0001
+#define PCI_COMMAND_MEMORY 0x0002
+#define PCI_COMMAND_BUS_MASTER 0x0004
+#define PCI_BAR_IO 0x01
+#define PCI_BAR_IO_MASK 0xFFFFFFFC
+
+typedef struct {
+    uint8_t bus;
+    uint8_t device;
+    uint8_t function;
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint8_t class_code;
+    uint8_t subclass;
+} pci_device_t;
+
+int pci_init(void);
+const pci_device_t* pci_find(uint16_t vendor_id, uint16_t device_id);
+uint32_t pci_read32(const pci_device_t* dev, uint8_t offset);
+uint16_t pci_read16(const pci_device_t* dev, uint8_t offset);
+uint8_t pci_read8(const pci_device_t* dev, uint8_t offset);
+void pci_write32(const pci_device_t* dev, uint8_t offset, uint32_t value);
+void pci_write16(const pci_device_t* dev, uint8_t offset, uint16_t value);
+void pci_enable(const pci_device_t* dev, uint16_t command_bits);
+
+#endif
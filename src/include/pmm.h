@@ -0,0 +1,22 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define PAGE_SIZE 4096
+
+// One bit per 4 KB page over the 32-bit physical address space
+#define PMM_MAX_PAGES 0x100000
+
+// Used when the bootloader gives us no memory information
+#define PMM_FALLBACK_MEMORY (32 * 1024 * 1024)
+
+void pmm_init(uint32_t magic, multiboot_info_t* mbi);
+void* pmm_alloc_pages(unsigned int count);
+void pmm_free_pages(void* address, unsigned int count);
+unsigned int pmm_total_pages(void);
+unsigned int pmm_free_page_count(void);
+unsigned int pmm_largest_free_run(void);
+
+#endif
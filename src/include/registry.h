@@ -0,0 +1,44 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "types.h"
+
+// Command flags
+#define COMMAND_RAW 0x01           // Takes the rest of the line unparsed
+#define COMMAND_FILE_ARG 0x02      // Tab completes files only
+#define COMMAND_DIR_ARG 0x04       // Tab completes directories only
+
+#define COMMAND_MAX_ARGS 2
+#define COMMAND_MAX_NAME 16
+
+typedef void (*command_handler_t)(void);
+
+typedef struct {
+    const char* name;
+    const char* alias;
+    unsigned char min_args;
+    unsigned char max_args;
+    unsigned char flags;
+    command_handler_t handler;     // Cast back to its real arity on dispatch
+    const char* usage;
+    const char* help;
+} command_t;
+
+extern const command_t command_table[];
+extern const int command_count;
+
+const command_t* command_find(const char* name);
+void command_run(const char* line);
+
+// Seeded FNV-1a. tools/gen_command_hash.c searches for a seed that puts every
+// command name and alias in its own slot.
+static inline uint32_t command_hash(const char* name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 16);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "filesystem.h"
+#include "types.h"
+
+// Image of the RAM disk at the end of the block device: the payload laid
+// out by fs_snapshot_save(), then a header in the very last sector. The
+// header is written last, so an interrupted SAVE leaves the old image or
+// one whose checksum fails.
+#define SNAPSHOT_MAGIC 0x50414E53  // "SNAP"
+#define SNAPSHOT_VERSION 1
+
+// Results of snapshot_save() and snapshot_load()
+#define SNAPSHOT_OK 0
+#define SNAPSHOT_NO_DISK 1
+#define SNAPSHOT_NO_ROOM 2         // Would run into the FAT volume
+#define SNAPSHOT_NOT_FOUND 3       // No image, or one from another format version
+#define SNAPSHOT_TOO_LARGE 4       // Taken with more files or blocks than fit now
+#define SNAPSHOT_IO_ERROR 5
+#define SNAPSHOT_DAMAGED 6         // Checksum mismatch; the default tree is back
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t entry_size;           // Layout checks for the raw tables
+    uint32_t block_size;
+    uint32_t max_filename;
+    uint32_t payload_bytes;
+    uint32_t payload_sectors;      // Directly before the header
+    uint32_t payload_checksum;     // Adler-32
+    fs_snapshot_info_t info;
+    uint32_t header_checksum;      // Adler-32 of everything above
+} snapshot_header_t;
+
+int snapshot_save(void);
+int snapshot_load(void);
+
+#endif
@@ -9,8 +9,17 @@ char* strcat(char* dest, const char* src);
 int strcmp(const char* s1, const char* s2);
 int strncmp(const char* s1, const char* s2, size_t n);
 void itoa(int value, char* str, int base);
+uint64_t udiv64(uint64_t dividend, uint32_t divisor, uint32_t* remainder);
+void u64toa(uint64_t value, char* str);
 char* strchr(const char* s, int c);
 char* strrchr(const char* s, int c);
+char* strstr(const char* haystack, const char* needle);
+void* memcpy(void* dest, const void* src, size_t n);
+void* memmove(void* dest, const void* src, size_t n);
+void* memset(void* dest, int value, size_t n);
+void* memsetw(void* dest, uint16_t value, size_t count);
+void string_set_sse2(int enabled);
+int string_get_sse2(void);
 void strtok(char* str, const char* delim, char** saveptr, char** token);
 
 #endif
\ No newline at end of file
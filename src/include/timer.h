@@ -0,0 +1,25 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "types.h"
+
+// 8253/8254 programmable interval timer
+#define PIT_FREQUENCY 1193182
+#define PIT_CHANNEL0 0x40
+#define PIT_CHANNEL2 0x42
+#define PIT_COMMAND 0x43
+#define PIT_GATE_PORT 0x61         // Channel 2 gate (bit 0) and output (bit 5)
+
+// Periodic tick rate on IRQ 0
+#define TIMER_HZ 100
+
+// Length of the PIT window the TSC is calibrated against
+#define TIMER_CALIBRATE_MS 10
+
+void timer_init(void);
+uint32_t timer_ticks(void);
+uint32_t timer_tsc_khz(void);
+uint64_t timer_now_ns(void);
+uint64_t timer_cycles_to_ns(uint64_t cycles);
+
+#endif
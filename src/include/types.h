@@ -14,6 +14,8 @@ typedef signed short int16_t;
 typedef signed int int32_t;
 typedef signed long long int64_t;
 
-typedef unsigned int size_t;
+// Pointer-sized, so the same code also builds for a 64-bit host
+typedef __SIZE_TYPE__ size_t;
+typedef __UINTPTR_TYPE__ uintptr_t;
 
 #endif
\ No newline at end of file
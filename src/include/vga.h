@@ -6,11 +6,20 @@
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
 
+// Colour text mode maps 32 KB of cells at 0xB8000
+#define VGA_TEXT_MEMORY_CELLS 16384
+
 // VGA cursor control registers
 #define VGA_CRTC_ADDR_REG 0x3D4
 #define VGA_CRTC_DATA_REG 0x3D5
 #define VGA_CURSOR_LOC_HIGH 0x0E
 #define VGA_CURSOR_LOC_LOW 0x0F
+#define VGA_START_ADDR_HIGH 0x0C
+#define VGA_START_ADDR_LOW 0x0D
+
+// Scroll strategies
+#define VGA_SCROLL_COPY 0       // Redraw every row on each scroll
+#define VGA_SCROLL_HARDWARE 1   // Move the CRTC start address
 
 enum vga_color {
     VGA_COLOR_BLACK = 0,
@@ -41,11 +50,15 @@ unsigned short vga_entry(unsigned char c, unsigned char color);
 void vga_init(void);
 void vga_set_color(enum vga_color fg, enum vga_color bg);
 void vga_putchar(char c);
+void vga_putchar_at(char c, int x, int y);
 void vga_write(const char* data, int size);
 void vga_print(const char* str);
 void vga_println(const char* str);
 void vga_clear_screen(void);
 void vga_update_cursor(void);
+void vga_flush(void);
 void vga_scroll(void);
+void vga_set_scroll_mode(int mode);
+int vga_get_scroll_mode(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include "blockdev.h"
+#include "types.h"
+
+// Legacy (virtio 0.9.5) block device over PCI, as QEMU's -drive if=virtio
+#define VIRTIO_VENDOR_ID 0x1AF4
+#define VIRTIO_BLK_DEVICE_ID 0x1001    // Transitional ID, which keeps the I/O port interface
+
+// Registers in the I/O space of BAR0
+#define VIRTIO_REG_DEVICE_FEATURES 0x00
+#define VIRTIO_REG_GUEST_FEATURES 0x04
+#define VIRTIO_REG_QUEUE_ADDRESS 0x08  // Page number of the ring
+#define VIRTIO_REG_QUEUE_SIZE 0x0C
+#define VIRTIO_REG_QUEUE_SELECT 0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY 0x10
+#define VIRTIO_REG_STATUS 0x12
+#define VIRTIO_REG_CONFIG 0x14         // Device-specific fields, with MSI-X off
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER 0x02
+#define VIRTIO_STATUS_DRIVER_OK 0x04
+#define VIRTIO_STATUS_FAILED 0x80
+
+#define VIRTQ_DESC_F_NEXT 0x01
+#define VIRTQ_DESC_F_WRITE 0x02        // Device writes into the buffer
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 0x01
+#define VIRTQ_ALIGN 4096               // The used ring starts on its own page
+
+#define VIRTIO_BLK_F_FLUSH (1 << 9)
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+#define VIRTIO_BLK_T_FLUSH 4
+#define VIRTIO_BLK_S_OK 0
+
+// Every request is a chain of three descriptors: header, data, status.
+// Request slot i owns descriptors 3i to 3i+2 for good.
+#define VIRTIO_BLK_CHAIN 3
+#define VIRTIO_BLK_MAX_DEPTH 64
+#define VIRTIO_BLK_MAX_TRANSFER 256    // Sectors per request
+#define VIRTIO_BLK_TIMEOUT 100000000   // Polls of the used ring before giving up
+
+typedef struct {
+    uint64_t address;
+    uint32_t length;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t index;
+    uint16_t ring[];
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct {
+    uint32_t id;                   // Head descriptor of the finished chain
+    uint32_t length;
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t index;
+    virtq_used_elem_t ring[];
+} __attribute__((packed)) virtq_used_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_header_t;
+
+int virtio_blk_init(void);
+
+// Filled in by virtio_blk_init()
+extern blockdev_t virtio_blk_device;
+
+#endif
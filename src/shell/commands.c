@@ -4,6 +4,35 @@
 #include "string.h"
 #include "keyboard.h"
 #include "constants.h"
+#include "io.h"
+#include "idt.h"
+#include "heap.h"
+#include "registry.h"
+#include "timer.h"
+#include "blockdev.h"
+#include "bcache.h"
+#include "snapshot.h"
+#include "types.h"
+
+#define HELP_LABEL_WIDTH 15
+#define SCROLLBENCH_LINES 200
+#define FINDBENCH_ROUNDS 100
+#define FINDBENCH_MAX_FILES 1024
+#define FINDBENCH_SAMPLES 64
+#define BENCH_SAMPLES 15
+#define BENCH_FILES 32
+#define BENCH_STRING_MAX 256
+#define BENCH_BLOCK_SIZE 4096
+#define DISKBENCH_SPAN 8192            // Sectors the runs cover (4 MiB)
+#define DISKBENCH_CHUNK 8              // Sectors per sequential request
+#define DISKBENCH_RAW_SECTORS 1024
+#define DISKBENCH_RANDOM_READS 2048
+#define DISKBENCH_HOT_SECTORS 256
+#define IOBENCH_SPAN 65536             // Sectors the random requests land in (32 MiB)
+#define IOBENCH_REQUESTS 2048          // Requests per run
+#define IOBENCH_BUFFER (1024 * 1024)   // Shared by the requests in flight
+#define IOBENCH_RANDOM_SECTORS 8       // 4 KiB random reads
+#define IOBENCH_SEQUENTIAL_SECTORS 128 // 64 KiB sequential reads
 
 
 void resolve_path(const char* path, char* full_path) {
@@ -32,32 +61,41 @@ void cmd_version(void) {
 
 void cmd_help(void) {
     vga_println("Available commands:");
-    vga_println("CAT       - Displays the contents of a file");
-    vga_println("CD        - Changes the current directory");
-    vga_println("CLS       - Clears the screen");
-    vga_println("COLORTEST - Displays a color test");
-    vga_println("COPY      - Copies a file");
-    vga_println("DEL       - Deletes a file");
-    vga_println("DIR       - Lists files and directories");
-    vga_println("ECHO      - Displays messages or toggles command echoing");
-    vga_println("HELP      - Shows this help message");
-    vga_println("MKDIR     - Creates a directory");
-    vga_println("MOVE      - Moves a file");
-    vga_println("REN       - Renames a file");
-    vga_println("RM        - Removes a file (alias for DEL)");
-    vga_println("RMDIR     - Removes a directory");
-    vga_println("TOUCH     - Creates an empty file");
-    vga_println("VER       - Shows version information");
+    
+    for (int i = 0; i < command_count; i++) {
+        const command_t* command = &command_table[i];
+        char label[COMMAND_MAX_NAME * 2 + 4];
+        
+        // "NAME (ALIAS)" in uppercase
+        strcpy(label, command->name);
+        if (command->alias) {
+            strcat(label, " (");
+            strcat(label, command->alias);
+            strcat(label, ")");
+        }
+        for (int j = 0; label[j]; j++) {
+            if (label[j] >= 'a' && label[j] <= 'z') {
+                label[j] -= 32;
+            }
+        }
+        
+        vga_print(label);
+        for (int pad = HELP_LABEL_WIDTH - strlen(label); pad > 0; pad--) {
+            vga_putchar(' ');
+        }
+        vga_print(" - ");
+        vga_println(command->help);
+    }
 }
 
 void cmd_dir_path(const char* path) {
     char target_path[FS_MAX_FILENAME];
-    int is_root;
+    fs_file_t* dir;
     
     if (path && path[0] != '\0') {
         resolve_path(path, target_path);
         
-        fs_file_t* dir = fs_find(target_path);
+        dir = fs_find(target_path);
         if (!dir) {
             vga_print("Directory not found: ");
             vga_println(path);
@@ -68,11 +106,13 @@ void cmd_dir_path(const char* path) {
             vga_println("Not a directory");
             return;
         }
-        
-        is_root = (strcmp(target_path, "\\") == 0);
     } else {
         strcpy(target_path, fs_current_dir);
-        is_root = (strcmp(fs_current_dir, "\\") == 0);
+        dir = fs_find(target_path);
+        if (!dir) {
+            vga_println("Directory not found");
+            return;
+        }
     }
     
     vga_print(" Directory of C:");
@@ -82,69 +122,24 @@ void cmd_dir_path(const char* path) {
     int file_count = 0;
     int dir_count = 0;
     unsigned int total_size = 0;
-    int target_path_len = strlen(target_path);
     
-    if (!is_root) {
+    if (fs_parent(dir)) {
         vga_print("<DIR>          ");
         vga_println("..");
         dir_count++;
     }
     
-    for (int i = 0; i < fs_file_count; i++) {
-        if (strcmp(fs_files[i].name, "\\") == 0) {
-            continue;
-        }
-        
-        int file_path_len = strlen(fs_files[i].name);
-        int is_in_target_dir = 0;
-        
-        if (is_root) {
-            int backslash_count = 0;
-            for (int j = 0; j < file_path_len; j++) {
-                if (fs_files[i].name[j] == '\\') {
-                    backslash_count++;
-                }
-            }
-            
-            is_in_target_dir = (backslash_count == 1 && fs_files[i].name[0] == '\\');
-        } else {
-            if (file_path_len > target_path_len && 
-                strncmp(fs_files[i].name, target_path, target_path_len) == 0 &&
-                fs_files[i].name[target_path_len] == '\\') {
-                
-                int additional_backslashes = 0;
-                for (int j = target_path_len + 1; j < file_path_len; j++) {
-                    if (fs_files[i].name[j] == '\\') {
-                        additional_backslashes++;
-                    }
-                }
-                
-                is_in_target_dir = (additional_backslashes == 0);
-            }
-        }
-        
-        if (!is_in_target_dir) {
-            continue;
-        }
-        
-        char name_only[FS_MAX_FILENAME];
-        int name_start;
-        
-        if (is_root) {
-            name_start = 1;
-        } else {
-            name_start = target_path_len + 1;
-        }
+    // Only this directory's own children are visited
+    for (fs_file_t* entry = fs_first_child(dir); entry; entry = fs_next_child(entry)) {
+        const char* name_only = fs_basename(entry);
         
-        strcpy(name_only, &fs_files[i].name[name_start]);
-        
-        if (fs_files[i].type == FS_DIRECTORY) {
+        if (entry->type == FS_DIRECTORY) {
             vga_print("<DIR>          ");
             vga_println(name_only);
             dir_count++;
         } else {
             char size_str[16];
-            itoa(fs_files[i].size, size_str, 10);
+            itoa(entry->size, size_str, 10);
             
             int pad = 14 - strlen(size_str);
             for (int j = 0; j < pad; j++) {
@@ -156,7 +151,7 @@ void cmd_dir_path(const char* path) {
             vga_println(name_only);
             
             file_count++;
-            total_size += fs_files[i].size;
+            total_size += entry->size;
         }
     }
     
@@ -187,20 +182,30 @@ void cmd_type(const char* filename) {
     char full_path[FS_MAX_FILENAME];
     resolve_path(filename, full_path);
     
-    fs_file_t* file = fs_find(full_path);
-    
-    if (!file) {
-        vga_print("File not found: ");
-        vga_println(full_path);
+    fs_map_t map;
+    unsigned int size;
+    if (!fs_map(full_path, &size, &map)) {
+        if (fs_find(full_path)) {
+            vga_println("Cannot display directory contents");
+        } else {
+            vga_print("File not found: ");
+            vga_println(full_path);
+        }
         return;
     }
     
-    if (file->type == FS_DIRECTORY) {
-        vga_println("Cannot display directory contents");
-        return;
+    // Straight from where the data is stored to the console
+    const char* span;
+    unsigned int shown = 0;
+    while (shown < size) {
+        unsigned int length = fs_map_next(&map, &span);
+        if (length == 0) {
+            break;
+        }
+        vga_write(span, length);
+        shown += length;
     }
-    
-    vga_println(file->content);
+    vga_println("");
 }
 
 void cmd_copy(const char* source, const char* dest) {
@@ -323,6 +328,10 @@ void cmd_move(const char* source, const char* dest) {
         resolve_path(dest, dest_full_path);
     }
     
+    // Directories move with their whole subtree
+    fs_file_t* source_file = fs_find(source_full_path);
+    int is_directory = source_file && source_file->type == FS_DIRECTORY;
+    
     fs_file_t* dest_file = fs_find(dest_full_path);
     if (dest_file && dest_file->type == FS_DIRECTORY) {
         char source_filename[FS_MAX_FILENAME];
@@ -353,7 +362,11 @@ void cmd_move(const char* source, const char* dest) {
         }
     }
     
-    vga_println("        1 file(s) moved");
+    if (is_directory) {
+        vga_println("        1 dir(s) moved");
+    } else {
+        vga_println("        1 file(s) moved");
+    }
 }
 
 void cmd_del(const char* filename) {
@@ -405,26 +418,12 @@ void cmd_cd(const char* dirname) {
     
     // Case 3: Go up one directory
     if (strcmp(dirname, "..") == 0) {
-        // If already at root, do nothing
-        if (strcmp(fs_current_dir, "\\") == 0) {
-            return;
-        }
+        fs_file_t* current = fs_find(fs_current_dir);
+        fs_file_t* parent = current ? fs_parent(current) : 0;
         
-        // Find the last backslash in the current path
-        int last_slash = -1;
-        for (int i = strlen(fs_current_dir) - 1; i >= 0; i--) {
-            if (fs_current_dir[i] == '\\') {
-                last_slash = i;
-                break;
-            }
-        }
-        
-        // If we found a backslash that's not at position 0, truncate after it
-        if (last_slash > 0) {
-            fs_current_dir[last_slash] = '\0';
-        } else {
-            // If the backslash is at position 0, we're going to root
-            strcpy(fs_current_dir, "\\");
+        // If already at root, do nothing
+        if (parent) {
+            strcpy(fs_current_dir, parent->name);
         }
         return;
     }
@@ -539,21 +538,11 @@ void cmd_rmdir(const char* dirname) {
         return;
     }
     
-    // Check if it's not empty (has files or subdirectories)
-    int path_len = strlen(full_path);
-    for (int i = 0; i < fs_file_count; i++) {
-        // Skip the directory itself
-        if (strcmp(fs_files[i].name, full_path) == 0) {
-            continue;
-        }
-        
-        // Check if any file or directory is inside this directory
-        if (strlen(fs_files[i].name) > path_len && 
-            strncmp(fs_files[i].name, full_path, path_len) == 0 && 
-            fs_files[i].name[path_len] == '\\') {
-            vga_println("Directory not empty");
-            return;
-        }
+    // Check if it's not empty (has files or subdirectories). Asking for the
+    // first child reads a mounted directory in if that hasn't happened yet.
+    if (fs_first_child(dir)) {
+        vga_println("Directory not empty");
+        return;
     }
     
     // Delete the directory
@@ -598,6 +587,704 @@ void cmd_colortest(void) {
     vga_color = original_color;
 }
 
+// Print enough lines to keep the console scrolling and time the whole run
+static uint64_t scrollbench_run(int mode) {
+    vga_set_scroll_mode(mode);
+    vga_flush();
+    
+    uint64_t start = rdtsc();
+    for (int i = 0; i < SCROLLBENCH_LINES; i++) {
+        vga_println("SCROLLBENCH: the quick brown fox jumps over the lazy dog");
+    }
+    return rdtsc() - start;
+}
+
+static void scrollbench_report(const char* label, uint64_t cycles) {
+    char cycles_str[24];
+    u64toa(udiv64(cycles, SCROLLBENCH_LINES, NULL), cycles_str);
+    
+    vga_print(label);
+    vga_print(cycles_str);
+    vga_println(" cycles/line");
+}
+
+void cmd_scrollbench(void) {
+    int original_mode = vga_get_scroll_mode();
+    
+    uint64_t copy_cycles = scrollbench_run(VGA_SCROLL_COPY);
+    uint64_t hardware_cycles = scrollbench_run(VGA_SCROLL_HARDWARE);
+    
+    vga_set_scroll_mode(original_mode);
+    
+    vga_println("");
+    scrollbench_report("Copy scroll:     ", copy_cycles);
+    scrollbench_report("Hardware scroll: ", hardware_cycles);
+}
+
+// The lookup fs_find() used before the hash index, kept as a baseline
+static fs_file_t* findbench_linear(const char* name) {
+    for (int i = 0; i < fs_slot_count; i++) {
+        if (fs_files[i].type != FS_FREE && strcmp(fs_files[i].name, name) == 0) {
+            return &fs_files[i];
+        }
+    }
+    return 0;
+}
+
+static void findbench_name(char* name, const char* prefix, int n) {
+    char number[16];
+    itoa(n, number, 10);
+    strcpy(name, prefix);
+    strcat(name, number);
+}
+
+// Look up FINDBENCH_SAMPLES names spread evenly over the `count` created
+static uint64_t findbench_run(fs_file_t* (*find)(const char*), const char* prefix, int count) {
+    char name[FS_MAX_FILENAME];
+    uint64_t total = 0;
+    int samples = count < FINDBENCH_SAMPLES ? count : FINDBENCH_SAMPLES;
+    
+    for (int round = 0; round < FINDBENCH_ROUNDS; round++) {
+        for (int i = 0; i < samples; i++) {
+            findbench_name(name, prefix, i * count / samples);
+            
+            uint64_t start = rdtsc();
+            find(name);
+            total += rdtsc() - start;
+        }
+    }
+    
+    return udiv64(total, FINDBENCH_ROUNDS * samples, NULL);
+}
+
+static void findbench_report(const char* label, uint64_t cycles) {
+    char cycles_str[24];
+    u64toa(cycles, cycles_str);
+    
+    vga_print(label);
+    vga_print(cycles_str);
+    vga_println(" cycles/lookup");
+}
+
+void cmd_findbench(void) {
+    char name[FS_MAX_FILENAME];
+    int created = 0;
+    
+    // Fill the volume with throwaway files
+    while (fs_file_count < fs_max_files && created < FINDBENCH_MAX_FILES) {
+        findbench_name(name, "\\FINDBENCH.", created);
+        if (!fs_create_file(name, "")) {
+            break;
+        }
+        created++;
+    }
+    
+    if (created == 0) {
+        vga_println("No free entries to benchmark with");
+        return;
+    }
+    
+    char entries_str[16];
+    itoa(fs_file_count, entries_str, 10);
+    vga_print("Entries: ");
+    vga_println(entries_str);
+    
+    findbench_report("Hash hit:    ", findbench_run(fs_find, "\\FINDBENCH.", created));
+    findbench_report("Hash miss:   ", findbench_run(fs_find, "\\MISSING.", created));
+    findbench_report("Linear hit:  ", findbench_run(findbench_linear, "\\FINDBENCH.", created));
+    findbench_report("Linear miss: ", findbench_run(findbench_linear, "\\MISSING.", created));
+    
+    for (int i = 0; i < created; i++) {
+        findbench_name(name, "\\FINDBENCH.", i);
+        fs_delete(name);
+    }
+}
+
+// BENCH workloads. Each one runs `count` operations on fixed inputs, so
+// results are comparable from one build to the next.
+static char bench_string_a[BENCH_STRING_MAX];
+static char bench_string_b[BENCH_STRING_MAX];
+static char bench_screen[VGA_WIDTH * VGA_HEIGHT + 1];
+static char bench_block_a[BENCH_BLOCK_SIZE];
+static char bench_block_b[BENCH_BLOCK_SIZE];
+static int bench_length;
+
+static void bench_set_length(int length) {
+    bench_length = length;
+    if (length >= BENCH_STRING_MAX) {
+        return;
+    }
+    
+    for (int i = 0; i < length; i++) {
+        bench_string_a[i] = 'A' + i % 26;
+        bench_string_b[i] = 'A' + i % 26;
+    }
+    bench_string_a[length] = '\0';
+    bench_string_b[length] = '\0';
+}
+
+static void bench_strlen(int count) {
+    for (int i = 0; i < count; i++) {
+        strlen(bench_string_a);
+    }
+}
+
+static void bench_strcmp(int count) {
+    for (int i = 0; i < count; i++) {
+        strcmp(bench_string_a, bench_string_b);
+    }
+}
+
+static void bench_strcpy(int count) {
+    for (int i = 0; i < count; i++) {
+        strcpy(bench_string_b, bench_string_a);
+    }
+}
+
+static void bench_memcpy(int count) {
+    for (int i = 0; i < count; i++) {
+        memcpy(bench_block_b, bench_block_a, bench_length);
+    }
+}
+
+static void bench_memset(int count) {
+    for (int i = 0; i < count; i++) {
+        memset(bench_block_b, i, bench_length);
+    }
+}
+
+static void bench_find_hit(int count) {
+    char name[FS_MAX_FILENAME];
+    for (int i = 0; i < count; i++) {
+        findbench_name(name, "\\BENCH.", i % BENCH_FILES);
+        fs_find(name);
+    }
+}
+
+static void bench_find_miss(int count) {
+    char name[FS_MAX_FILENAME];
+    for (int i = 0; i < count; i++) {
+        findbench_name(name, "\\NOBENCH.", i % BENCH_FILES);
+        fs_find(name);
+    }
+}
+
+static void bench_churn(int count) {
+    for (int i = 0; i < count; i++) {
+        if (fs_create_file("\\BENCH.TMP", "churn")) {
+            fs_delete("\\BENCH.TMP");
+        }
+    }
+}
+
+static void bench_print_screen(int count) {
+    for (int i = 0; i < count; i++) {
+        vga_print(bench_screen);
+    }
+}
+
+static void bench_scroll(int count) {
+    for (int i = 0; i < count; i++) {
+        vga_scroll();
+        vga_flush();
+    }
+}
+
+typedef struct {
+    const char* name;
+    void (*run)(int count);
+    int length;                // Input size for the string and memory workloads
+    int count;                 // Operations per sample
+} bench_case_t;
+
+typedef struct {
+    uint64_t min;
+    uint64_t median;
+    uint64_t max;
+} bench_result_t;
+
+static const bench_case_t bench_cases[] = {
+    { "strlen 8",        bench_strlen,       8,   1000 },
+    { "strlen 64",       bench_strlen,       64,  1000 },
+    { "strlen 255",      bench_strlen,       255, 200 },
+    { "strcmp 8",        bench_strcmp,       8,   1000 },
+    { "strcmp 64",       bench_strcmp,       64,  1000 },
+    { "strcmp 255",      bench_strcmp,       255, 200 },
+    { "strcpy 8",        bench_strcpy,       8,   1000 },
+    { "strcpy 64",       bench_strcpy,       64,  1000 },
+    { "strcpy 255",      bench_strcpy,       255, 200 },
+    { "memcpy 64",       bench_memcpy,       64,  1000 },
+    { "memcpy 4096",     bench_memcpy,       4096, 100 },
+    { "memset 4096",     bench_memset,       4096, 100 },
+    { "fs_find hit",     bench_find_hit,     0,   BENCH_FILES * 8 },
+    { "fs_find miss",    bench_find_miss,    0,   BENCH_FILES * 8 },
+    { "create+delete",   bench_churn,        0,   64 },
+    { "vga_print screen", bench_print_screen, 0,  4 },
+    { "vga_scroll",      bench_scroll,       0,   100 },
+};
+
+#define BENCH_CASE_COUNT (int)(sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+// Time BENCH_SAMPLES batches and keep min/median/max cycles per operation.
+// Interrupts stay off during a batch so the timer tick doesn't land in it.
+static void bench_measure(const bench_case_t* bench, bench_result_t* result) {
+    uint64_t samples[BENCH_SAMPLES];
+    
+    bench_set_length(bench->length);
+    bench->run(bench->count);  // Warm-up
+    
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        interrupts_disable();
+        uint64_t start = rdtsc();
+        bench->run(bench->count);
+        uint64_t cycles = rdtsc() - start;
+        interrupts_enable();
+        
+        // Insertion sort as we go
+        int j = i;
+        uint64_t per_op = udiv64(cycles, bench->count, NULL);
+        while (j > 0 && samples[j - 1] > per_op) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = per_op;
+    }
+    
+    result->min = samples[0];
+    result->median = samples[BENCH_SAMPLES / 2];
+    result->max = samples[BENCH_SAMPLES - 1];
+}
+
+static void bench_print_cycles(uint64_t cycles, int width) {
+    char cycles_str[24];
+    u64toa(cycles, cycles_str);
+    
+    for (int pad = width - strlen(cycles_str); pad > 0; pad--) {
+        vga_putchar(' ');
+    }
+    vga_print(cycles_str);
+}
+
+void cmd_bench(void) {
+    char name[FS_MAX_FILENAME];
+    bench_result_t results[BENCH_CASE_COUNT];
+    int created = 0;
+    
+    // The churn workload deletes \BENCH.TMP, so it mustn't be a user's file
+    if (fs_find("\\BENCH.TMP")) {
+        vga_println("\\BENCH.TMP already exists");
+        return;
+    }
+    
+    // Fixed set of files for the lookup workloads. Stop at the first name
+    // that can't be created, so cleanup only touches files made here.
+    while (created < BENCH_FILES) {
+        findbench_name(name, "\\BENCH.", created);
+        if (!fs_create_file(name, "bench")) {
+            break;
+        }
+        created++;
+    }
+    
+    if (created < BENCH_FILES) {
+        vga_println("Not enough free entries to benchmark with");
+    } else {
+        for (int i = 0; i < VGA_WIDTH * VGA_HEIGHT; i++) {
+            bench_screen[i] = 'a' + i % 26;
+        }
+        bench_screen[VGA_WIDTH * VGA_HEIGHT] = '\0';
+        
+        for (int i = 0; i < BENCH_CASE_COUNT; i++) {
+            bench_measure(&bench_cases[i], &results[i]);
+        }
+        
+        // The console workloads leave the screen full of filler
+        vga_clear_screen();
+        vga_print("String routines: ");
+        vga_println(string_get_sse2() ? "SSE2" : "word-at-a-time");
+        vga_println("Workload                  Min     Median        Max  (cycles/op)");
+        for (int i = 0; i < BENCH_CASE_COUNT; i++) {
+            vga_print(bench_cases[i].name);
+            for (int pad = 18 - strlen(bench_cases[i].name); pad > 0; pad--) {
+                vga_putchar(' ');
+            }
+            bench_print_cycles(results[i].min, 11);
+            bench_print_cycles(results[i].median, 11);
+            bench_print_cycles(results[i].max, 11);
+            vga_println("");
+        }
+    }
+    
+    for (int i = 0; i < created; i++) {
+        findbench_name(name, "\\BENCH.", i);
+        fs_delete(name);
+    }
+}
+
+// Print nanoseconds as milliseconds with three decimals
+static void print_elapsed(uint64_t ns) {
+    char number[24];
+    uint32_t micros;
+    uint64_t millis = udiv64(udiv64(ns, 1000, NULL), 1000, &micros);
+    
+    u64toa(millis, number);
+    vga_print(number);
+    vga_putchar('.');
+    
+    itoa(micros, number, 10);
+    for (int i = strlen(number); i < 3; i++) {
+        vga_putchar('0');
+    }
+    vga_print(number);
+    vga_print(" ms");
+}
+
+// TIME <command>: run a command and report how long it took
+void cmd_time(const char* line) {
+    uint64_t start_ns = timer_now_ns();
+    uint64_t start_cycles = rdtsc();
+    
+    command_run(line);
+    
+    uint64_t cycles = rdtsc() - start_cycles;
+    uint64_t elapsed_ns = timer_now_ns() - start_ns;
+    
+    char cycles_str[24];
+    u64toa(cycles, cycles_str);
+    
+    vga_print("Elapsed: ");
+    print_elapsed(elapsed_ns);
+    vga_print(" (");
+    vga_print(cycles_str);
+    vga_println(" cycles)");
+}
+
+// Right-align a number in a column of `width` characters
+static void print_padded(unsigned int value, int width) {
+    char value_str[16];
+    itoa(value, value_str, 10);
+    
+    int pad = width - strlen(value_str);
+    for (int i = 0; i < pad; i++) {
+        vga_putchar(' ');
+    }
+    vga_print(value_str);
+}
+
+void cmd_mem(void) {
+    vga_println(" Class   In use     Peak    Slabs    Used%");
+    
+    for (int i = 0; i < KHEAP_CLASS_COUNT; i++) {
+        kheap_class_stats_t stats;
+        kheap_get_class_stats(i, &stats);
+        
+        // Share of slab slots holding live objects
+        unsigned int used_percent = 0;
+        if (stats.capacity > 0) {
+            used_percent = stats.in_use * 100 / stats.capacity;
+        }
+        
+        print_padded(stats.object_size, 6);
+        print_padded(stats.in_use, 9);
+        print_padded(stats.peak, 9);
+        print_padded(stats.slabs, 9);
+        print_padded(used_percent, 8);
+        vga_println("%");
+    }
+    
+    kheap_page_stats_t pages;
+    kheap_get_page_stats(&pages);
+    
+    unsigned int fragmentation = 0;
+    if (pages.free_pages > 0) {
+        fragmentation = 100 - pages.largest_free_run * 100 / pages.free_pages;
+    }
+    
+    vga_println("");
+    vga_print("Memory: ");
+    print_padded(pages.total_pages * (PAGE_SIZE / 1024), 1);
+    vga_print(" KB, ");
+    print_padded(pages.free_pages * (PAGE_SIZE / 1024), 1);
+    vga_println(" KB free");
+    
+    vga_print("Files: ");
+    print_padded(fs_file_count, 1);
+    vga_print(" of ");
+    print_padded(fs_max_files, 1);
+    vga_print(" entries, ");
+    print_padded(fs_free_blocks(), 1);
+    vga_print(" of ");
+    print_padded(fs_max_blocks, 1);
+    vga_println(" blocks free");
+    
+    vga_print("Heap pages:");
+    print_padded(pages.used_pages, 6);
+    vga_print(" used, peak ");
+    print_padded(pages.peak_pages, 1);
+    vga_print(", ");
+    print_padded(pages.large_allocations, 1);
+    vga_println(" large allocation(s)");
+    
+    vga_print("Largest free run: ");
+    print_padded(pages.largest_free_run, 1);
+    vga_print(" pages, fragmentation ");
+    print_padded(fragmentation, 1);
+    vga_println("%");
+}
+
+// DISKBENCH: throughput of the disk driver on its own and through the
+// sector cache. The write run only rewrites data it has just read, and
+// stops at the first read that fails, so the disk is left as it was.
+static uint8_t diskbench_buffer[DISKBENCH_CHUNK * BLOCKDEV_SECTOR_SIZE];
+static uint64_t diskbench_start;
+static uint32_t diskbench_seed;
+
+static uint32_t diskbench_random(uint32_t range) {
+    diskbench_seed = diskbench_seed * 1103515245 + 12345;
+    return (diskbench_seed >> 8) % range;
+}
+
+static void diskbench_begin(int cold) {
+    if (cold) {
+        bcache_invalidate();
+    }
+    bcache_reset_stats();
+    diskbench_start = timer_now_ns();
+}
+
+static void diskbench_end(const char* name, unsigned int sectors, unsigned int requests, int cached) {
+    uint64_t micros = udiv64(timer_now_ns() - diskbench_start, 1000, NULL);
+    if (micros == 0) {
+        micros = 1;
+    }
+    
+    bcache_stats_t stats;
+    bcache_get_stats(&stats);
+    
+    vga_print(name);
+    for (int pad = 20 - strlen(name); pad > 0; pad--) {
+        vga_putchar(' ');
+    }
+    print_padded(udiv64((uint64_t)sectors * BLOCKDEV_SECTOR_SIZE * 1000000 / 1024, micros, NULL), 8);
+    print_padded(udiv64((uint64_t)requests * 1000000, micros, NULL), 8);
+    
+    unsigned int lookups = stats.hits + stats.misses;
+    if (cached && lookups > 0) {
+        print_padded(stats.hits * 100 / lookups, 6);
+        vga_putchar('%');
+        print_padded(stats.device_reads + stats.device_writes, 7);
+    } else {
+        vga_print("      -");
+        print_padded(requests, 7);
+    }
+    vga_println("");
+}
+
+void cmd_diskbench(void) {
+    blockdev_t* disk = bcache_get_device();
+    if (!disk) {
+        vga_println("No disk found");
+        return;
+    }
+    
+    uint32_t span = disk->sectors;
+    if (span > DISKBENCH_SPAN) {
+        span = DISKBENCH_SPAN;
+    }
+    span -= span % DISKBENCH_CHUNK;
+    if (span < DISKBENCH_HOT_SECTORS) {
+        vga_println("Disk too small to benchmark");
+        return;
+    }
+    diskbench_seed = 1;
+    
+    vga_print("Disk: ");
+    vga_print(disk->name);
+    vga_print(", ");
+    print_padded(disk->sectors / 2048, 1);
+    vga_println(" MB");
+    vga_println("Workload                KB/s   IO/s   Hits  Cmds");
+    
+    // One command per sector, no cache: the driver's floor
+    unsigned int raw = span < DISKBENCH_RAW_SECTORS ? span : DISKBENCH_RAW_SECTORS;
+    diskbench_begin(1);
+    for (uint32_t lba = 0; lba < raw; lba++) {
+        disk->read(lba, 1, diskbench_buffer);
+    }
+    diskbench_end("Raw, 1 sector", raw, raw, 0);
+    
+    diskbench_begin(1);
+    for (uint32_t lba = 0; lba < span; lba += DISKBENCH_CHUNK) {
+        bcache_read(lba, DISKBENCH_CHUNK, diskbench_buffer);
+    }
+    diskbench_end("Sequential read", span, span / DISKBENCH_CHUNK, 1);
+    
+    diskbench_begin(1);
+    for (int i = 0; i < DISKBENCH_RANDOM_READS; i++) {
+        bcache_read(diskbench_random(span), 1, diskbench_buffer);
+    }
+    diskbench_end("Random read", DISKBENCH_RANDOM_READS, DISKBENCH_RANDOM_READS, 1);
+    
+    // A working set that fits in the cache
+    diskbench_begin(1);
+    for (int i = 0; i < DISKBENCH_RANDOM_READS; i++) {
+        bcache_read(diskbench_random(DISKBENCH_HOT_SECTORS), 1, diskbench_buffer);
+    }
+    diskbench_end("Random read, hot", DISKBENCH_RANDOM_READS, DISKBENCH_RANDOM_READS, 1);
+    
+    // Write-back turns the rewrites into a few large commands at the flush
+    diskbench_begin(1);
+    for (uint32_t lba = 0; lba < span; lba += DISKBENCH_CHUNK) {
+        if (!bcache_read(lba, DISKBENCH_CHUNK, diskbench_buffer)) {
+            bcache_flush();
+            vga_println("Sequential rewrite: read failed, stopping");
+            return;
+        }
+        bcache_write(lba, DISKBENCH_CHUNK, diskbench_buffer);
+    }
+    bcache_flush();
+    diskbench_end("Sequential rewrite", span * 2, span / DISKBENCH_CHUNK * 2, 1);
+}
+
+// IOBENCH: requests straight to the block device, past the cache, with
+// more and more of them in flight. Requests share slices of one buffer, so
+// two in flight can land on the same slice; the data is thrown away.
+static blockdev_request_t iobench_requests[IOBENCH_REQUESTS];
+
+static void iobench_run(blockdev_t* disk, const char* name, unsigned int sectors, unsigned int depth,
+                        uint32_t span, int sequential, uint8_t* buffer) {
+    unsigned int request_bytes = sectors * BLOCKDEV_SECTOR_SIZE;
+    unsigned int slices = IOBENCH_BUFFER / request_bytes;
+    uint32_t lba = 0;
+    
+    for (int i = 0; i < IOBENCH_REQUESTS; i++) {
+        blockdev_request_t* request = &iobench_requests[i];
+        if (sequential) {
+            if (lba + sectors > span) {
+                lba = 0;
+            }
+            request->lba = lba;
+            lba += sectors;
+        } else {
+            request->lba = diskbench_random(span / sectors) * sectors;
+        }
+        request->count = sectors;
+        request->buffer = buffer + i % slices * request_bytes;
+        request->write = 0;
+    }
+    
+    uint64_t start = timer_now_ns();
+    int done = disk->submit(iobench_requests, IOBENCH_REQUESTS, depth);
+    uint64_t micros = udiv64(timer_now_ns() - start, 1000, NULL);
+    if (micros == 0) {
+        micros = 1;
+    }
+    
+    // Bytes per microsecond is MB/s; keep one decimal
+    uint32_t tenth;
+    uint32_t megabytes = udiv64(udiv64((uint64_t)done * request_bytes * 10, micros, NULL), 10, &tenth);
+    
+    vga_print(name);
+    for (int pad = 20 - strlen(name); pad > 0; pad--) {
+        vga_putchar(' ');
+    }
+    print_padded(depth, 6);
+    print_padded(megabytes, 8);
+    vga_putchar('.');
+    print_padded(tenth, 1);
+    print_padded(udiv64((uint64_t)done * 1000000, micros, NULL), 8);
+    if (done != IOBENCH_REQUESTS) {
+        vga_print("  ");
+        print_padded(IOBENCH_REQUESTS - done, 1);
+        vga_print(" failed");
+    }
+    vga_println("");
+}
+
+void cmd_iobench(void) {
+    blockdev_t* disk = bcache_get_device();
+    if (!disk) {
+        vga_println("No disk found");
+        return;
+    }
+    
+    uint32_t span = disk->sectors < IOBENCH_SPAN ? disk->sectors : IOBENCH_SPAN;
+    if (span < IOBENCH_SEQUENTIAL_SECTORS * 4) {
+        vga_println("Disk too small to benchmark");
+        return;
+    }
+    
+    uint8_t* buffer = kmalloc(IOBENCH_BUFFER);
+    if (!buffer) {
+        vga_println("Out of memory");
+        return;
+    }
+    diskbench_seed = 1;
+    
+    vga_print("Disk: ");
+    vga_print(disk->name);
+    vga_print(", up to ");
+    print_padded(disk->max_depth, 1);
+    vga_println(" requests in flight");
+    vga_println("Workload             Depth      MB/s   Req/s");
+    
+    unsigned int random_slices = IOBENCH_BUFFER / (IOBENCH_RANDOM_SECTORS * BLOCKDEV_SECTOR_SIZE);
+    for (unsigned int depth = 1; depth <= disk->max_depth && depth <= random_slices; depth *= 4) {
+        iobench_run(disk, "Random read 4K", IOBENCH_RANDOM_SECTORS, depth, span, 0, buffer);
+    }
+    
+    unsigned int sequential_slices = IOBENCH_BUFFER / (IOBENCH_SEQUENTIAL_SECTORS * BLOCKDEV_SECTOR_SIZE);
+    for (unsigned int depth = 1; depth <= disk->max_depth && depth <= sequential_slices; depth *= 4) {
+        iobench_run(disk, "Sequential read 64K", IOBENCH_SEQUENTIAL_SECTORS, depth, span, 1, buffer);
+    }
+    
+    kfree(buffer);
+}
+
+static void print_snapshot_status(int status) {
+    switch (status) {
+        case SNAPSHOT_NO_DISK:
+            vga_println("No disk found");
+            break;
+        case SNAPSHOT_NO_ROOM:
+            vga_println("Not enough room on the disk after the FAT volume");
+            break;
+        case SNAPSHOT_NOT_FOUND:
+            vga_println("No saved filesystem on the disk");
+            break;
+        case SNAPSHOT_TOO_LARGE:
+            vga_println("Saved filesystem is too large for this machine's memory");
+            break;
+        case SNAPSHOT_DAMAGED:
+            vga_println("Saved filesystem is damaged; default files restored");
+            break;
+        default:
+            vga_println("Disk error");
+            break;
+    }
+}
+
+void cmd_save(void) {
+    int status = snapshot_save();
+    if (status != SNAPSHOT_OK) {
+        print_snapshot_status(status);
+        return;
+    }
+    
+    vga_println("Filesystem saved");
+}
+
+void cmd_load(void) {
+    int status = snapshot_load();
+    if (status != SNAPSHOT_OK) {
+        print_snapshot_status(status);
+        return;
+    }
+    
+    print_padded(fs_file_count, 1);
+    vga_println(" entries loaded");
+}
+
 void cmd_touch(const char* filename) {
     char full_path[FS_MAX_FILENAME];
     resolve_path(filename, full_path);
@@ -0,0 +1,90 @@
+#include "history.h"
+#include "string.h"
+#include "types.h"
+
+static char history_arena[HISTORY_ARENA_SIZE];
+
+// Arena offset of each entry, a ring indexed oldest to newest
+static int history_offsets[HISTORY_MAX_ENTRIES];
+static int history_oldest;
+static int history_count;
+static int history_write;          // Where the next entry goes
+
+void history_init(void) {
+    history_oldest = 0;
+    history_count = 0;
+    history_write = 0;
+}
+
+static int history_slot(int age) {
+    return (history_oldest + history_count - 1 - age) & (HISTORY_MAX_ENTRIES - 1);
+}
+
+static void history_drop_oldest(void) {
+    history_oldest = (history_oldest + 1) & (HISTORY_MAX_ENTRIES - 1);
+    history_count--;
+}
+
+void history_add(const char* command) {
+    int size = strlen(command) + 1;
+    
+    // Don't add empty commands, duplicates of the last command or lines the
+    // arena could never hold
+    if (size == 1 || size > HISTORY_ARENA_SIZE) {
+        return;
+    }
+    if (history_count > 0 && strcmp(command, history_entry(0)) == 0) {
+        return;
+    }
+    
+    if (history_count == HISTORY_MAX_ENTRIES) {
+        history_drop_oldest();
+    }
+    
+    // Entries never straddle the end of the arena. Skipping the tail frees
+    // whatever older entries were still sitting there.
+    int start = history_write;
+    int wrapped = start + size > HISTORY_ARENA_SIZE;
+    if (wrapped) {
+        start = 0;
+    }
+    
+    // Entries lie in arena order from oldest to newest, so only the oldest
+    // can be in the way
+    while (history_count > 0) {
+        int offset = history_offsets[history_oldest];
+        int in_tail = wrapped && offset >= history_write;
+        int overlaps = offset >= start && offset < start + size;
+        if (!in_tail && !overlaps) {
+            break;
+        }
+        history_drop_oldest();
+    }
+    
+    memcpy(&history_arena[start], command, size);
+    history_offsets[(history_oldest + history_count) & (HISTORY_MAX_ENTRIES - 1)] = start;
+    history_count++;
+    history_write = start + size;
+}
+
+int history_length(void) {
+    return history_count;
+}
+
+const char* history_entry(int age) {
+    if (age < 0 || age >= history_count) {
+        return NULL;
+    }
+    return &history_arena[history_offsets[history_slot(age)]];
+}
+
+// Age of the newest entry at `age` or older that contains `pattern`, -1 if
+// there is none
+int history_find(const char* pattern, int age) {
+    for (; age < history_count; age++) {
+        if (strstr(history_entry(age), pattern)) {
+            return age;
+        }
+    }
+    return -1;
+}
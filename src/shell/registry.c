@@ -0,0 +1,117 @@
+#include "registry.h"
+#include "commands.h"
+#include "vga.h"
+#include "string.h"
+#include "kernel.h"
+#include "types.h"
+#include "command_hash.h"
+
+typedef void (*command_handler0_t)(void);
+typedef void (*command_handler1_t)(const char* arg1);
+typedef void (*command_handler2_t)(const char* arg1, const char* arg2);
+
+const command_t command_table[] = {
+#define COMMAND(name, alias, min_args, max_args, flags, handler, usage, help) \
+    { name, alias, min_args, max_args, flags, (command_handler_t)handler, usage, help },
+#include "command_list.h"
+#undef COMMAND
+};
+
+const int command_count = sizeof(command_table) / sizeof(command_table[0]);
+
+static const short command_slots[COMMAND_HASH_SIZE] = COMMAND_HASH_SLOTS;
+
+// One hash and one strcmp, however many commands there are
+const command_t* command_find(const char* name) {
+    int value = command_slots[command_hash(name, COMMAND_HASH_SEED) & (COMMAND_HASH_SIZE - 1)];
+    if (value < 0) {
+        return NULL;
+    }
+    
+    const command_t* command = &command_table[value / 2];
+    const char* candidate = (value & 1) ? command->alias : command->name;
+    
+    return strcmp(candidate, name) == 0 ? command : NULL;
+}
+
+// Copy the next space-separated word of `line` into `word`, lowercased if
+// asked. Returns the rest of the line.
+static const char* command_next_word(const char* line, char* word, int size, int lowercase) {
+    int length = 0;
+    
+    while (*line == ' ') {
+        line++;
+    }
+    
+    while (*line && *line != ' ') {
+        char c = *line++;
+        if (lowercase && c >= 'A' && c <= 'Z') {
+            c += 32;
+        }
+        if (length < size - 1) {
+            word[length++] = c;
+        }
+    }
+    
+    word[length] = '\0';
+    return line;
+}
+
+void command_run(const char* line) {
+    char name[COMMAND_MAX_NAME];
+    const char* rest = command_next_word(line, name, sizeof(name), 1);
+    
+    if (name[0] == '\0') {
+        return;
+    }
+    
+    const command_t* command = command_find(name);
+    if (!command) {
+        vga_print("Bad command or file name: ");
+        vga_println(name);
+        return;
+    }
+    
+    char args[COMMAND_MAX_ARGS + 1][MAX_COMMAND_LENGTH];
+    int argc = 0;
+    
+    if (command->flags & COMMAND_RAW) {
+        // Everything after the single separating space, spacing preserved
+        if (*rest == ' ') {
+            rest++;
+        }
+        strcpy(args[0], rest);
+        argc = args[0][0] != '\0';
+    } else {
+        // Parse one word past the limit to catch extra arguments
+        while (argc <= COMMAND_MAX_ARGS) {
+            rest = command_next_word(rest, args[argc], MAX_COMMAND_LENGTH, 0);
+            if (args[argc][0] == '\0') {
+                break;
+            }
+            argc++;
+        }
+    }
+    
+    if (argc < command->min_args || argc > command->max_args) {
+        vga_print("Syntax: ");
+        vga_println(command->usage);
+        return;
+    }
+    
+    for (int i = argc; i < COMMAND_MAX_ARGS; i++) {
+        args[i][0] = '\0';
+    }
+    
+    switch (command->max_args) {
+    case 0:
+        ((command_handler0_t)command->handler)();
+        break;
+    case 1:
+        ((command_handler1_t)command->handler)(args[0]);
+        break;
+    default:
+        ((command_handler2_t)command->handler)(args[0], args[1]);
+        break;
+    }
+}
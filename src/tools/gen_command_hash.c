@@ -0,0 +1,83 @@
+// Build-time generator for the shell's command hash. Prints a header with a
+// seed and slot table such that command_hash() maps every name and alias in
+// command_list.h to a distinct slot.
+//
+// Slot values are command_index * 2 for a name and command_index * 2 + 1 for
+// an alias, or -1 for an empty slot.
+#include "registry.h"
+
+int printf(const char* format, ...);
+
+#define GEN_MAX_NAMES 256
+#define GEN_MAX_SIZE 4096
+#define GEN_MAX_SEEDS 1000000
+
+typedef struct {
+    const char* name;
+    int value;
+} gen_name_t;
+
+static gen_name_t names[GEN_MAX_NAMES];
+static int name_count = 0;
+static int slots[GEN_MAX_SIZE];
+
+static void add_name(const char* name, int value) {
+    if (name) {
+        names[name_count].name = name;
+        names[name_count].value = value;
+        name_count++;
+    }
+}
+
+static int try_seed(uint32_t seed, int size) {
+    for (int i = 0; i < size; i++) {
+        slots[i] = -1;
+    }
+
+    for (int i = 0; i < name_count; i++) {
+        uint32_t slot = command_hash(names[i].name, seed) & (size - 1);
+        if (slots[slot] != -1) {
+            return 0;
+        }
+        slots[slot] = names[i].value;
+    }
+    return 1;
+}
+
+int main(void) {
+    int index = 0;
+
+#define COMMAND(name, alias, min_args, max_args, flags, handler, usage, help) \
+    add_name(name, index * 2); \
+    add_name(alias, index * 2 + 1); \
+    index++;
+#include "command_list.h"
+#undef COMMAND
+
+    int size = 1;
+    while (size < name_count * 2) {
+        size <<= 1;
+    }
+
+    for (; size <= GEN_MAX_SIZE; size <<= 1) {
+        for (uint32_t seed = 1; seed <= GEN_MAX_SEEDS; seed++) {
+            if (!try_seed(seed, size)) {
+                continue;
+            }
+
+            printf("// Generated by tools/gen_command_hash.c from command_list.h\n");
+            printf("#define COMMAND_HASH_SEED %uu\n", seed);
+            printf("#define COMMAND_HASH_SIZE %d\n", size);
+            printf("#define COMMAND_HASH_SLOTS {");
+            for (int i = 0; i < size; i++) {
+                const char* separator = i == 0 ? " \\\n    " : i % 16 ? ", " : ", \\\n    ";
+                printf("%s%d", separator, slots[i]);
+            }
+            printf(" \\\n}\n");
+            return 0;
+        }
+    }
+
+    printf("#error no perfect hash seed found for command_list.h\n");
+    return 1;
+}
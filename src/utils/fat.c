@@ -0,0 +1,717 @@
+#include "fat.h"
+#include "bcache.h"
+#include "filesystem.h"
+#include "heap.h"
+#include "string.h"
+#include "types.h"
+
+// One mounted FAT volume. Sector numbers are absolute LBAs on the disk.
+static uint32_t fat_table_start;       // First copy of the FAT
+static uint32_t fat_table_sectors;     // Size of each copy
+static unsigned int fat_table_count;
+static uint32_t fat_root_start;        // Fixed-size root directory region
+static unsigned int fat_root_sectors;
+static uint32_t fat_data_start;        // Cluster 2
+static uint32_t fat_end;               // First sector past the volume
+static unsigned int fat_cluster_sectors;
+static unsigned int fat_cluster_bytes;
+static unsigned int fat_clusters;      // Data clusters, numbered from FAT_FIRST_CLUSTER
+static int fat_is_fat16;
+
+static uint8_t* fat_table;             // Whole FAT in memory, written through on change
+static unsigned int fat_next_free;     // Where the next allocation starts looking
+static unsigned int fat_free_clusters;
+
+static uint8_t fat_sector[FAT_SECTOR_SIZE];    // Bounce buffer for partial sectors and entries
+
+// Walks the sectors of a directory: the root region or a cluster chain
+typedef struct {
+    uint32_t cluster;                  // 0 while in the root region
+    unsigned int sector;               // Within the cluster or the root region
+    uint32_t lba;
+} fat_cursor_t;
+
+static uint32_t fat_cluster_lba(uint32_t cluster) {
+    return fat_data_start + (cluster - FAT_FIRST_CLUSTER) * fat_cluster_sectors;
+}
+
+// Anything that isn't a data cluster ends the chain. fat_get and fat_set
+// refuse such clusters too, so a damaged table or directory entry can't
+// send a walk off the end of the table or the disk.
+static int fat_is_end(uint32_t value) {
+    return value < FAT_FIRST_CLUSTER || value >= fat_clusters + FAT_FIRST_CLUSTER;
+}
+
+static uint32_t fat_get(uint32_t cluster) {
+    if (fat_is_end(cluster)) {
+        return fat_is_fat16 ? FAT16_END : FAT12_END;
+    }
+    
+    if (fat_is_fat16) {
+        return fat_table[cluster * 2] | fat_table[cluster * 2 + 1] << 8;
+    }
+    
+    // FAT12 packs two entries into three bytes
+    unsigned int offset = cluster + cluster / 2;
+    uint32_t value = fat_table[offset] | fat_table[offset + 1] << 8;
+    return cluster & 1 ? value >> 4 : value & FAT12_END;
+}
+
+static int fat_set(uint32_t cluster, uint32_t value) {
+    unsigned int offset;
+    
+    if (fat_is_end(cluster)) {
+        return 0;
+    }
+    
+    if (fat_is_fat16) {
+        offset = cluster * 2;
+        fat_table[offset] = value & 0xFF;
+        fat_table[offset + 1] = value >> 8;
+    } else {
+        offset = cluster + cluster / 2;
+        if (cluster & 1) {
+            fat_table[offset] = (fat_table[offset] & 0x0F) | (value << 4 & 0xF0);
+            fat_table[offset + 1] = value >> 4;
+        } else {
+            fat_table[offset] = value & 0xFF;
+            fat_table[offset + 1] = (fat_table[offset + 1] & 0xF0) | (value >> 8 & 0x0F);
+        }
+    }
+    
+    // A FAT12 entry can straddle two sectors
+    uint32_t first = offset / FAT_SECTOR_SIZE;
+    uint32_t count = (offset + 1) / FAT_SECTOR_SIZE - first + 1;
+    for (unsigned int copy = 0; copy < fat_table_count; copy++) {
+        uint32_t lba = fat_table_start + copy * fat_table_sectors + first;
+        if (!bcache_write(lba, count, fat_table + first * FAT_SECTOR_SIZE)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Take a free cluster and end the chain with it, appending it to `previous`
+// unless that is 0. Returns 0 when the disk is full.
+static uint32_t fat_alloc_cluster(uint32_t previous) {
+    if (fat_free_clusters == 0) {
+        return 0;
+    }
+    
+    uint32_t last = fat_clusters + FAT_FIRST_CLUSTER;
+    uint32_t cluster = fat_next_free;
+    while (fat_get(cluster) != 0) {
+        cluster = cluster + 1 == last ? FAT_FIRST_CLUSTER : cluster + 1;
+    }
+    
+    if (!fat_set(cluster, fat_is_fat16 ? FAT16_END : FAT12_END)) {
+        return 0;
+    }
+    if (previous && !fat_set(previous, cluster)) {
+        fat_set(cluster, 0);
+        return 0;
+    }
+    
+    fat_free_clusters--;
+    fat_next_free = cluster + 1 == last ? FAT_FIRST_CLUSTER : cluster + 1;
+    return cluster;
+}
+
+static void fat_free_chain(uint32_t cluster) {
+    while (!fat_is_end(cluster)) {
+        uint32_t next = fat_get(cluster);
+        fat_set(cluster, 0);
+        fat_free_clusters++;
+        cluster = next;
+    }
+}
+
+static int fat_zero_cluster(uint32_t cluster) {
+    uint32_t lba = fat_cluster_lba(cluster);
+    
+    memset(fat_sector, 0, FAT_SECTOR_SIZE);
+    for (unsigned int i = 0; i < fat_cluster_sectors; i++) {
+        if (!bcache_write(lba + i, 1, fat_sector)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Directory location 0 is the root region; anything else is its first cluster
+static void fat_cursor_start(fat_cursor_t* cursor, uint32_t location) {
+    cursor->cluster = location;
+    cursor->sector = 0;
+    cursor->lba = location ? fat_cluster_lba(location) : fat_root_start;
+}
+
+static int fat_cursor_next(fat_cursor_t* cursor) {
+    cursor->sector++;
+    if (cursor->cluster == 0) {
+        cursor->lba++;
+        return cursor->sector < fat_root_sectors;
+    }
+    
+    if (cursor->sector < fat_cluster_sectors) {
+        cursor->lba++;
+        return 1;
+    }
+    
+    uint32_t next = fat_get(cursor->cluster);
+    if (fat_is_end(next)) {
+        return 0;
+    }
+    fat_cursor_start(cursor, next);
+    return 1;
+}
+
+// Directory entries are identified by sector and position in it
+static uint32_t fat_record(uint32_t lba, unsigned int index) {
+    return lba * FAT_DIRENTS_PER_SECTOR + index;
+}
+
+// Read the sector holding a directory entry into fat_sector
+static fat_dirent_t* fat_load_record(uint32_t record) {
+    if (!bcache_read(record / FAT_DIRENTS_PER_SECTOR, 1, fat_sector)) {
+        return 0;
+    }
+    return (fat_dirent_t*)fat_sector + record % FAT_DIRENTS_PER_SECTOR;
+}
+
+static int fat_store_record(uint32_t record) {
+    return bcache_write(record / FAT_DIRENTS_PER_SECTOR, 1, fat_sector);
+}
+
+// "README  TXT" -> "README.TXT"
+static void fat_name_to_string(const uint8_t* raw, char* name) {
+    int length = 0;
+    
+    for (int i = 0; i < 8 && raw[i] != ' '; i++) {
+        name[length++] = raw[i];
+    }
+    if (raw[0] == FAT_ENTRY_KANJI_E5) {
+        name[0] = (char)FAT_ENTRY_DELETED;
+    }
+    
+    if (raw[8] != ' ') {
+        name[length++] = '.';
+        for (int i = 8; i < FAT_NAME_LENGTH && raw[i] != ' '; i++) {
+            name[length++] = raw[i];
+        }
+    }
+    name[length] = '\0';
+}
+
+// "README.TXT" -> "README  TXT". Only names that DOS itself would accept
+// are taken, so nothing written here looks odd to other systems.
+static int fat_string_to_name(const char* name, uint8_t* raw) {
+    int position = 0;
+    int limit = 8;
+    
+    memset(raw, ' ', FAT_NAME_LENGTH);
+    for (const char* c = name; *c; c++) {
+        if (*c == '.') {
+            if (limit != 8 || c == name) {
+                return 0;
+            }
+            position = 8;
+            limit = FAT_NAME_LENGTH;
+            continue;
+        }
+        
+        if (*c <= ' ' || (*c >= 'a' && *c <= 'z') || strchr("\"*+,/:;<=>?[\\]|", *c) || position == limit) {
+            return 0;
+        }
+        raw[position++] = *c;
+    }
+    
+    // No empty name and no trailing dot
+    return limit == 8 ? position > 0 : position > 8;
+}
+
+// Find a free entry in a directory, growing it by a cluster if it isn't
+// the root region and is full
+static int fat_alloc_record(uint32_t location, uint32_t* record) {
+    fat_cursor_t cursor;
+    uint32_t last_cluster = location;
+    
+    fat_cursor_start(&cursor, location);
+    do {
+        if (!bcache_read(cursor.lba, 1, fat_sector)) {
+            return 0;
+        }
+        
+        fat_dirent_t* entries = (fat_dirent_t*)fat_sector;
+        for (unsigned int i = 0; i < FAT_DIRENTS_PER_SECTOR; i++) {
+            if (entries[i].name[0] == FAT_ENTRY_END || entries[i].name[0] == FAT_ENTRY_DELETED) {
+                *record = fat_record(cursor.lba, i);
+                return 1;
+            }
+        }
+        if (cursor.cluster) {
+            last_cluster = cursor.cluster;
+        }
+    } while (fat_cursor_next(&cursor));
+    
+    if (location == 0) {
+        return 0;
+    }
+    
+    uint32_t cluster = fat_alloc_cluster(last_cluster);
+    if (!cluster) {
+        return 0;
+    }
+    if (!fat_zero_cluster(cluster)) {
+        return 0;
+    }
+    *record = fat_record(fat_cluster_lba(cluster), 0);
+    return 1;
+}
+
+static void fat_fill_dirent(fat_dirent_t* dirent, const uint8_t* raw, uint8_t attributes, uint32_t cluster) {
+    memset(dirent, 0, sizeof(fat_dirent_t));
+    memcpy(dirent->name, raw, FAT_NAME_LENGTH);
+    dirent->attributes = attributes;
+    dirent->cluster_low = cluster;
+}
+
+// Move bytes between `buffer` and the file's clusters. Whole sectors go
+// straight through the cache; the ends of the range use the bounce buffer.
+// A NULL buffer writes zeros.
+static int fat_transfer(const fs_file_t* file, unsigned int offset, char* buffer,
+                        unsigned int length, int writing) {
+    uint32_t cluster = file->location;
+    
+    for (unsigned int skip = offset / fat_cluster_bytes; skip > 0; skip--) {
+        if (fat_is_end(cluster)) {
+            return 0;
+        }
+        cluster = fat_get(cluster);
+    }
+    
+    while (length > 0) {
+        if (fat_is_end(cluster)) {
+            return 0;
+        }
+        
+        unsigned int in_cluster = offset % fat_cluster_bytes;
+        uint32_t lba = fat_cluster_lba(cluster) + in_cluster / FAT_SECTOR_SIZE;
+        unsigned int in_sector = in_cluster % FAT_SECTOR_SIZE;
+        unsigned int chunk;
+        
+        if (in_sector == 0 && length >= FAT_SECTOR_SIZE && buffer) {
+            // Run of whole sectors up to the end of the cluster
+            unsigned int sectors = (fat_cluster_bytes - in_cluster) / FAT_SECTOR_SIZE;
+            if (sectors > length / FAT_SECTOR_SIZE) {
+                sectors = length / FAT_SECTOR_SIZE;
+            }
+            chunk = sectors * FAT_SECTOR_SIZE;
+            
+            int ok = writing ? bcache_write(lba, sectors, buffer) : bcache_read(lba, sectors, buffer);
+            if (!ok) {
+                return 0;
+            }
+        } else {
+            chunk = FAT_SECTOR_SIZE - in_sector;
+            if (chunk > length) {
+                chunk = length;
+            }
+            
+            if (!writing) {
+                if (!bcache_read(lba, 1, fat_sector)) {
+                    return 0;
+                }
+                memcpy(buffer, fat_sector + in_sector, chunk);
+            } else {
+                // A sector that is only partly overwritten needs its old contents
+                if (chunk < FAT_SECTOR_SIZE && !bcache_read(lba, 1, fat_sector)) {
+                    return 0;
+                }
+                if (buffer) {
+                    memcpy(fat_sector + in_sector, buffer, chunk);
+                } else {
+                    memset(fat_sector + in_sector, 0, chunk);
+                }
+                if (!bcache_write(lba, 1, fat_sector)) {
+                    return 0;
+                }
+            }
+        }
+        
+        if (buffer) {
+            buffer += chunk;
+        }
+        offset += chunk;
+        length -= chunk;
+        if (offset % fat_cluster_bytes == 0) {
+            cluster = fat_get(cluster);
+        }
+    }
+    return 1;
+}
+
+static int fat_load(fs_file_t* dir) {
+    fat_cursor_t cursor;
+    char name[FS_MAX_FILENAME];
+    
+    fat_cursor_start(&cursor, dir->location);
+    do {
+        if (!bcache_read(cursor.lba, 1, fat_sector)) {
+            return 0;
+        }
+        
+        fat_dirent_t* entries = (fat_dirent_t*)fat_sector;
+        for (unsigned int i = 0; i < FAT_DIRENTS_PER_SECTOR; i++) {
+            fat_dirent_t* dirent = &entries[i];
+            
+            if (dirent->name[0] == FAT_ENTRY_END) {
+                return 1;
+            }
+            // Long name fragments carry the volume label bit too
+            if (dirent->name[0] == FAT_ENTRY_DELETED || dirent->name[0] == '.' ||
+                (dirent->attributes & FAT_ATTR_VOLUME_ID)) {
+                continue;
+            }
+            
+            // Skip entries whose first cluster is out of range. Only empty
+            // files may have none; a directory at cluster 0 would be the root.
+            int is_directory = dirent->attributes & FAT_ATTR_DIRECTORY;
+            if ((dirent->cluster_low || is_directory) && fat_is_end(dirent->cluster_low)) {
+                continue;
+            }
+            
+            fat_name_to_string(dirent->name, name);
+            fs_add_loaded(dir, name, is_directory ? FS_DIRECTORY : FS_FILE,
+                          is_directory ? 0 : dirent->size, dirent->cluster_low,
+                          fat_record(cursor.lba, i));
+        }
+    } while (fat_cursor_next(&cursor));
+    
+    return 1;
+}
+
+static unsigned int fat_read(const fs_file_t* file, unsigned int offset, char* buffer, unsigned int length) {
+    if (offset >= file->size) {
+        return 0;
+    }
+    if (length > file->size - offset) {
+        length = file->size - offset;
+    }
+    return fat_transfer(file, offset, buffer, length, 0) ? length : 0;
+}
+
+// Undo a failed write's growth: free the clusters it chained on after
+// `last`, or its whole new chain if the file had none, and put the size
+// and first cluster back
+static void fat_undo_growth(fs_file_t* file, uint32_t last, uint32_t location, unsigned int size) {
+    if (last) {
+        uint32_t added = fat_get(last);
+        if (!fat_is_end(added)) {
+            fat_free_chain(added);
+            fat_set(last, fat_is_fat16 ? FAT16_END : FAT12_END);
+        }
+    } else if (file->location != location) {
+        fat_free_chain(file->location);
+    }
+    
+    file->location = location;
+    file->size = size;
+}
+
+static unsigned int fat_write(fs_file_t* file, unsigned int offset, const char* data, unsigned int length) {
+    unsigned int end = offset + length;
+    if (end < offset) {
+        return 0;
+    }
+    
+    uint32_t old_location = file->location;
+    unsigned int old_size = file->size;
+    uint32_t last = 0;
+    
+    // Grow the chain to cover the new end of file first
+    unsigned int have = (file->size + fat_cluster_bytes - 1) / fat_cluster_bytes;
+    unsigned int need = (end + fat_cluster_bytes - 1) / fat_cluster_bytes;
+    if (need > have) {
+        if (need - have > fat_free_clusters) {
+            return 0;
+        }
+        
+        // A chain shorter than the size says is damage; don't grow it
+        if (have > 0) {
+            last = file->location;
+            for (unsigned int i = 1; i < have && !fat_is_end(last); i++) {
+                last = fat_get(last);
+            }
+            if (fat_is_end(last)) {
+                return 0;
+            }
+        }
+        
+        uint32_t tail = last;
+        for (unsigned int i = have; i < need; i++) {
+            tail = fat_alloc_cluster(tail);
+            if (!tail) {
+                fat_undo_growth(file, last, old_location, old_size);
+                return 0;
+            }
+            if (i == 0) {
+                file->location = tail;
+            }
+        }
+    }
+    
+    // Bytes between the old end of file and `offset` read back as zero
+    if ((offset > file->size && !fat_transfer(file, file->size, NULL, offset - file->size, 1)) ||
+        !fat_transfer(file, offset, (char*)data, length, 1)) {
+        fat_undo_growth(file, last, old_location, old_size);
+        return 0;
+    }
+    
+    if (end > file->size) {
+        file->size = end;
+    }
+    
+    fat_dirent_t* dirent = fat_load_record(file->record);
+    if (!dirent) {
+        fat_undo_growth(file, last, old_location, old_size);
+        return 0;
+    }
+    dirent->size = file->size;
+    dirent->cluster_low = file->location;
+    dirent->attributes |= FAT_ATTR_ARCHIVE;
+    if (!fat_store_record(file->record)) {
+        fat_undo_growth(file, last, old_location, old_size);
+        return 0;
+    }
+    return length;
+}
+
+static int fat_create(fs_file_t* entry) {
+    uint8_t raw[FAT_NAME_LENGTH];
+    uint32_t record;
+    uint32_t cluster = 0;
+    fs_file_t* parent = fs_parent(entry);
+    
+    if (!fat_string_to_name(fs_basename(entry), raw) || !fat_alloc_record(parent->location, &record)) {
+        return 0;
+    }
+    
+    // New directories start with "." and ".." in a cluster of their own
+    if (entry->type == FS_DIRECTORY) {
+        cluster = fat_alloc_cluster(0);
+        if (!cluster) {
+            return 0;
+        }
+        if (!fat_zero_cluster(cluster)) {
+            fat_free_chain(cluster);
+            return 0;
+        }
+        
+        uint8_t dots[FAT_NAME_LENGTH];
+        fat_dirent_t* entries = (fat_dirent_t*)fat_sector;
+        memset(dots, ' ', FAT_NAME_LENGTH);
+        dots[0] = '.';
+        fat_fill_dirent(&entries[0], dots, FAT_ATTR_DIRECTORY, cluster);
+        dots[1] = '.';
+        fat_fill_dirent(&entries[1], dots, FAT_ATTR_DIRECTORY, parent->location);
+        if (!bcache_write(fat_cluster_lba(cluster), 1, fat_sector)) {
+            fat_free_chain(cluster);
+            return 0;
+        }
+    }
+    
+    fat_dirent_t* dirent = fat_load_record(record);
+    if (!dirent) {
+        fat_free_chain(cluster);
+        return 0;
+    }
+    fat_fill_dirent(dirent, raw, entry->type == FS_DIRECTORY ? FAT_ATTR_DIRECTORY : FAT_ATTR_ARCHIVE, cluster);
+    if (!fat_store_record(record)) {
+        fat_free_chain(cluster);
+        return 0;
+    }
+    
+    entry->location = cluster;
+    entry->record = record;
+    return 1;
+}
+
+static int fat_remove(fs_file_t* entry) {
+    fat_dirent_t* dirent = fat_load_record(entry->record);
+    if (!dirent) {
+        return 0;
+    }
+    
+    dirent->name[0] = FAT_ENTRY_DELETED;
+    if (!fat_store_record(entry->record)) {
+        return 0;
+    }
+    
+    if (entry->location) {
+        fat_free_chain(entry->location);
+    }
+    return 1;
+}
+
+static int fat_rename(fs_file_t* entry, fs_file_t* new_parent, const char* new_name) {
+    uint8_t raw[FAT_NAME_LENGTH];
+    uint32_t record = entry->record;
+    
+    if (!fat_string_to_name(new_name, raw)) {
+        return 0;
+    }
+    
+    // Moving to another directory takes a new slot first, so a full
+    // directory leaves everything as it was
+    if (fs_parent(entry) != new_parent && !fat_alloc_record(new_parent->location, &record)) {
+        return 0;
+    }
+    
+    fat_dirent_t* dirent = fat_load_record(entry->record);
+    if (!dirent) {
+        return 0;
+    }
+    
+    fat_dirent_t moved = *dirent;
+    memcpy(moved.name, raw, FAT_NAME_LENGTH);
+    if (record != entry->record) {
+        dirent->name[0] = FAT_ENTRY_DELETED;
+    } else {
+        *dirent = moved;
+    }
+    if (!fat_store_record(entry->record)) {
+        return 0;
+    }
+    
+    if (record != entry->record) {
+        dirent = fat_load_record(record);
+        if (!dirent) {
+            return 0;
+        }
+        *dirent = moved;
+        if (!fat_store_record(record)) {
+            return 0;
+        }
+        entry->record = record;
+        
+        // ".." follows the directory to its new parent
+        if (entry->type == FS_DIRECTORY) {
+            uint32_t lba = fat_cluster_lba(entry->location);
+            if (!bcache_read(lba, 1, fat_sector)) {
+                return 0;
+            }
+            ((fat_dirent_t*)fat_sector)[1].cluster_low = new_parent->location;
+            if (!bcache_write(lba, 1, fat_sector)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static const fs_volume_t fat_volume = {
+    fat_load,
+    fat_read,
+    fat_write,
+    fat_create,
+    fat_remove,
+    fat_rename,
+    NULL,
+};
+
+// Check that a boot sector describes a FAT12/16 volume this driver can use
+static int fat_valid_bpb(const fat_bpb_t* bpb) {
+    unsigned int spc = bpb->sectors_per_cluster;
+    
+    // FAT32 has no fixed root directory and keeps its FAT size elsewhere
+    return bpb->bytes_per_sector == FAT_SECTOR_SIZE && spc != 0 && (spc & (spc - 1)) == 0 &&
+        bpb->reserved_sectors != 0 && bpb->fat_count != 0 && bpb->root_entries != 0 &&
+        bpb->sectors_per_fat != 0 && (bpb->total_sectors_16 != 0 || bpb->total_sectors_32 != 0);
+}
+
+static int fat_is_partition_type(uint8_t type) {
+    // FAT12, FAT16 < 32 MB, FAT16, FAT16 LBA
+    return type == 0x01 || type == 0x04 || type == 0x06 || type == 0x0E;
+}
+
+// Mount the disk's FAT volume at `path`. The volume either starts at the
+// first sector or is the first FAT partition in an MBR.
+int fat_mount(const char* path) {
+    uint32_t start = 0;
+    fat_bpb_t bpb;
+    
+    if (fat_table || !bcache_read(0, 1, fat_sector)) {
+        return 0;
+    }
+    if (*(uint16_t*)(fat_sector + FAT_SECTOR_SIZE - 2) != FAT_MBR_SIGNATURE) {
+        return 0;
+    }
+    
+    if (!fat_valid_bpb((fat_bpb_t*)fat_sector)) {
+        fat_partition_t* partitions = (fat_partition_t*)(fat_sector + FAT_MBR_PARTITIONS);
+        for (int i = 0; i < 4 && start == 0; i++) {
+            if (fat_is_partition_type(partitions[i].type)) {
+                start = partitions[i].lba_first;
+            }
+        }
+        if (start == 0 || !bcache_read(start, 1, fat_sector) || !fat_valid_bpb((fat_bpb_t*)fat_sector)) {
+            return 0;
+        }
+    }
+    memcpy(&bpb, fat_sector, sizeof(bpb));
+    
+    uint32_t total = bpb.total_sectors_16 ? bpb.total_sectors_16 : bpb.total_sectors_32;
+    fat_table_start = start + bpb.reserved_sectors;
+    fat_table_sectors = bpb.sectors_per_fat;
+    fat_table_count = bpb.fat_count;
+    fat_root_start = fat_table_start + fat_table_count * fat_table_sectors;
+    fat_root_sectors = (bpb.root_entries * sizeof(fat_dirent_t) + FAT_SECTOR_SIZE - 1) / FAT_SECTOR_SIZE;
+    fat_data_start = fat_root_start + fat_root_sectors;
+    fat_cluster_sectors = bpb.sectors_per_cluster;
+    fat_cluster_bytes = fat_cluster_sectors * FAT_SECTOR_SIZE;
+    
+    uint32_t overhead = fat_data_start - start;
+    if (total <= overhead) {
+        return 0;
+    }
+    fat_clusters = (total - overhead) / fat_cluster_sectors;
+    fat_end = start + total;
+    fat_is_fat16 = fat_clusters > FAT12_MAX_CLUSTERS;
+    
+    // Beyond FAT16 it would be FAT32, and the table must hold every cluster
+    uint32_t entries = fat_clusters + FAT_FIRST_CLUSTER;
+    uint32_t table_bytes = fat_is_fat16 ? entries * 2 : entries + entries / 2 + 1;
+    if (fat_clusters > FAT16_MAX_CLUSTERS || table_bytes > fat_table_sectors * FAT_SECTOR_SIZE) {
+        return 0;
+    }
+    
+    fat_table = kmalloc(fat_table_sectors * FAT_SECTOR_SIZE);
+    if (!fat_table) {
+        return 0;
+    }
+    if (!bcache_read(fat_table_start, fat_table_sectors, fat_table)) {
+        kfree(fat_table);
+        fat_table = 0;
+        return 0;
+    }
+    
+    fat_free_clusters = 0;
+    for (uint32_t cluster = FAT_FIRST_CLUSTER; cluster < entries; cluster++) {
+        if (fat_get(cluster) == 0) {
+            fat_free_clusters++;
+        }
+    }
+    fat_next_free = FAT_FIRST_CLUSTER;
+    
+    if (!fs_mount(path, &fat_volume, 0)) {
+        kfree(fat_table);
+        fat_table = 0;
+        return 0;
+    }
+    return 1;
+}
+
+// Where the rest of the disk is free for other uses; 0 when not mounted
+uint32_t fat_volume_end(void) {
+    return fat_table ? fat_end : 0;
+}
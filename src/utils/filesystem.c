@@ -1,15 +1,559 @@
 #include "filesystem.h"
 #include "string.h"
 #include "constants.h"
+#include "heap.h"
+#include "types.h"
 
-fs_file_t fs_files[FS_MAX_FILES];
+fs_file_t* fs_files = NULL;
 int fs_file_count = 0;
+int fs_slot_count = 0;
+int fs_max_files = 0;
+int fs_max_blocks = 0;
 char fs_current_dir[FS_MAX_FILENAME] = "\\";
 
-void fs_init(void) {
+// Deleted slots are chained through next_sibling and reused before fresh ones
+static int fs_free_entry_head = FS_NO_ENTRY;
+
+// Mounted volumes, indexed by fs_file_t.volume. While some directory is
+// still waiting to be loaded, a lookup miss has to check whether loading it
+// would produce the path.
+static const fs_volume_t* fs_volumes[FS_MAX_VOLUMES];
+static int fs_volume_count = 1;
+static int fs_unloaded_dirs = 0;
+
+// Block pool: each block links to the next one in its file's chain, and
+// unused blocks are chained together on a free list. A chain can be shared
+// by several files after COPY; the count of owners is kept on its head block.
+static char (*fs_block_data)[FS_BLOCK_SIZE] = NULL;
+static int* fs_block_next = NULL;
+static unsigned short* fs_block_refs = NULL;
+static int fs_free_block_head = FS_NO_BLOCK;
+static int fs_free_block_count = 0;
+
+// Open files. A handle whose file is deleted stays taken, failing every
+// call, until it is closed.
+typedef struct {
+    int open;
+    int file;                  // fs_files index, FS_NO_ENTRY once deleted
+    int mode;
+    unsigned int position;
+    fs_cursor_t cursor;
+} fs_handle_t;
+
+static fs_handle_t fs_handles[FS_MAX_HANDLES];
+
+// Handles on a file that is going away; FS_NO_ENTRY means every file
+static void fs_detach_handles(int file) {
+    for (int i = 0; i < FS_MAX_HANDLES; i++) {
+        if (file == FS_NO_ENTRY || fs_handles[i].file == file) {
+            fs_handles[i].file = FS_NO_ENTRY;
+        }
+    }
+}
+
+// Cached places in a chain that is about to be replaced or freed;
+// FS_NO_ENTRY means every file
+static void fs_forget_cursors(int file) {
+    for (int i = 0; i < FS_MAX_HANDLES; i++) {
+        if (file == FS_NO_ENTRY || fs_handles[i].file == file) {
+            fs_handles[i].cursor.block = FS_NO_BLOCK;
+        }
+    }
+}
+
+// Put every block from `first` on up on the free list
+static void fs_blocks_init(int first) {
+    for (int i = first; i < fs_max_blocks - 1; i++) {
+        fs_block_next[i] = i + 1;
+    }
+    if (first < fs_max_blocks) {
+        fs_block_next[fs_max_blocks - 1] = FS_NO_BLOCK;
+    }
+    
+    fs_free_block_head = first < fs_max_blocks ? first : FS_NO_BLOCK;
+    fs_free_block_count = fs_max_blocks - first;
+}
+
+// Take a chain of `count` blocks off the free list, or fail without side effects
+static int fs_alloc_chain(int count) {
+    if (count == 0) {
+        return FS_NO_BLOCK;
+    }
+    
+    if (count > fs_free_block_count) {
+        return FS_NO_BLOCK;
+    }
+    
+    int head = fs_free_block_head;
+    int last = head;
+    for (int i = 1; i < count; i++) {
+        last = fs_block_next[last];
+    }
+    
+    fs_free_block_head = fs_block_next[last];
+    fs_block_next[last] = FS_NO_BLOCK;
+    fs_free_block_count -= count;
+    fs_block_refs[head] = 1;
+    
+    return head;
+}
+
+static void fs_free_chain(int block) {
+    while (block != FS_NO_BLOCK) {
+        int next = fs_block_next[block];
+        fs_block_next[block] = fs_free_block_head;
+        fs_free_block_head = block;
+        fs_free_block_count++;
+        block = next;
+    }
+}
+
+// Written so that sizes near the top of the range don't wrap
+static int fs_blocks_needed(unsigned int size) {
+    return size / FS_BLOCK_SIZE + (size % FS_BLOCK_SIZE != 0);
+}
+
+// Drop one owner of a chain and free it once nobody uses it
+static void fs_release_chain(int head) {
+    if (head == FS_NO_BLOCK) {
+        return;
+    }
+    
+    if (--fs_block_refs[head] == 0) {
+        fs_free_chain(head);
+    }
+}
+
+// Give a file its own copy of a shared chain before it gets modified
+static int fs_make_private(fs_file_t* file) {
+    int head = file->first_block;
+    if (head == FS_NO_BLOCK || fs_block_refs[head] == 1) {
+        return 1;
+    }
+    
+    int copy = fs_alloc_chain(fs_blocks_needed(file->size));
+    if (copy == FS_NO_BLOCK) {
+        return 0;
+    }
+    
+    int src_block = head;
+    for (int block = copy; block != FS_NO_BLOCK; block = fs_block_next[block]) {
+        memcpy(fs_block_data[block], fs_block_data[src_block], FS_BLOCK_SIZE);
+        src_block = fs_block_next[src_block];
+    }
+    
+    fs_block_refs[head]--;
+    file->first_block = copy;
+    fs_forget_cursors(file - fs_files);
+    return 1;
+}
+
+// Path index: each slot holds an fs_files index, with the path hash cached
+// alongside so probes only strcmp on a full hash match.
+static int* fs_hash_slots = NULL;
+static uint32_t* fs_hash_keys = NULL;
+static int fs_hash_size = 0;
+static int fs_hash_tombstones = 0;
+
+// FNV-1a over the full path
+static uint32_t fs_hash_path(const char* path) {
+    uint32_t hash = 2166136261u;
+    while (*path) {
+        hash ^= (unsigned char)*path++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int fs_hash_find_slot(const char* name, uint32_t hash) {
+    uint32_t slot = hash & (fs_hash_size - 1);
+    
+    for (int probes = 0; probes < fs_hash_size; probes++) {
+        int index = fs_hash_slots[slot];
+        if (index == FS_HASH_EMPTY) {
+            return -1;
+        }
+        
+        if (index != FS_HASH_DELETED && fs_hash_keys[slot] == hash &&
+            strcmp(fs_files[index].name, name) == 0) {
+            return slot;
+        }
+        
+        slot = (slot + 1) & (fs_hash_size - 1);
+    }
+    
+    return -1;
+}
+
+static void fs_hash_place(int index, uint32_t hash) {
+    uint32_t slot = hash & (fs_hash_size - 1);
+    
+    while (fs_hash_slots[slot] >= 0) {
+        slot = (slot + 1) & (fs_hash_size - 1);
+    }
+    
+    if (fs_hash_slots[slot] == FS_HASH_DELETED) {
+        fs_hash_tombstones--;
+    }
+    
+    fs_hash_slots[slot] = index;
+    fs_hash_keys[slot] = hash;
+}
+
+static void fs_hash_clear(void) {
+    for (int i = 0; i < fs_hash_size; i++) {
+        fs_hash_slots[i] = FS_HASH_EMPTY;
+    }
+    fs_hash_tombstones = 0;
+}
+
+// Rebuild from the table once tombstones start lengthening probe chains
+static void fs_hash_rebuild(void) {
+    fs_hash_clear();
+    for (int i = 0; i < fs_slot_count; i++) {
+        if (fs_files[i].type != FS_FREE) {
+            fs_hash_place(i, fs_hash_path(fs_files[i].name));
+        }
+    }
+}
+
+static void fs_hash_insert(int index) {
+    fs_hash_place(index, fs_hash_path(fs_files[index].name));
+}
+
+static void fs_hash_remove_slot(int slot) {
+    fs_hash_slots[slot] = FS_HASH_DELETED;
+    fs_hash_tombstones++;
+}
+
+static void fs_hash_remove(const char* name) {
+    int slot = fs_hash_find_slot(name, fs_hash_path(name));
+    if (slot >= 0) {
+        fs_hash_remove_slot(slot);
+    }
+}
+
+static void fs_hash_compact(void) {
+    if (fs_hash_tombstones > fs_hash_size / 4) {
+        fs_hash_rebuild();
+    }
+}
+
+int fs_free_blocks(void) {
+    return fs_free_block_count;
+}
+
+// Block holding `offset`, walking on from the cursor unless it is already
+// past it. `offset` must be inside the chain.
+static int fs_cursor_seek(const fs_file_t* file, fs_cursor_t* cursor, unsigned int offset) {
+    if (cursor->block == FS_NO_BLOCK || cursor->start > offset) {
+        cursor->block = file->first_block;
+        cursor->start = 0;
+    }
+    
+    while (offset - cursor->start >= FS_BLOCK_SIZE) {
+        cursor->block = fs_block_next[cursor->block];
+        cursor->start += FS_BLOCK_SIZE;
+    }
+    return cursor->block;
+}
+
+// Copy up to `length` bytes starting at `offset` out of a file's block
+// chain, leaving the cursor on the last block read
+static unsigned int fs_read_at(const fs_file_t* file, unsigned int offset, char* buffer, unsigned int length,
+                               fs_cursor_t* cursor) {
+    if (file->volume != FS_VOLUME_RAM) {
+        return fs_volumes[file->volume]->read(file, offset, buffer, length);
+    }
+    
+    if (offset >= file->size) {
+        return 0;
+    }
+    
+    if (length > file->size - offset) {
+        length = file->size - offset;
+    }
+    
+    fs_cursor_seek(file, cursor, offset);
+    unsigned int block_offset = offset - cursor->start;
+    
+    unsigned int copied = 0;
+    while (copied < length) {
+        if (block_offset == FS_BLOCK_SIZE) {
+            cursor->block = fs_block_next[cursor->block];
+            cursor->start += FS_BLOCK_SIZE;
+            block_offset = 0;
+        }
+        
+        const char* src = fs_block_data[cursor->block] + block_offset;
+        unsigned int chunk = FS_BLOCK_SIZE - block_offset;
+        if (chunk > length - copied) {
+            chunk = length - copied;
+        }
+        
+        memcpy(buffer + copied, src, chunk);
+        copied += chunk;
+        block_offset += chunk;
+    }
+    
+    return copied;
+}
+
+unsigned int fs_read_data(const fs_file_t* file, unsigned int offset, char* buffer, unsigned int length) {
+    fs_cursor_t cursor = { FS_NO_BLOCK, 0 };
+    return fs_read_at(file, offset, buffer, length, &cursor);
+}
+
+// Write `length` bytes at `offset`, growing the chain as needed. A shared
+// chain is copied first so other files keep the old content. The cursor
+// is left on the last block written.
+static unsigned int fs_write_at(fs_file_t* file, unsigned int offset, const char* data, unsigned int length,
+                                fs_cursor_t* cursor) {
+    if (file->type != FS_FILE || length == 0) {
+        return 0;
+    }
+    
+    if (file->volume != FS_VOLUME_RAM) {
+        const fs_volume_t* volume = fs_volumes[file->volume];
+        return volume->write ? volume->write(file, offset, data, length) : 0;
+    }
+    
+    // The end of the write has to be a representable file size
+    if (offset + length < offset) {
+        return 0;
+    }
+    
+    int head = file->first_block;
+    if (!fs_make_private(file)) {
+        return 0;
+    }
+    if (file->first_block != head) {
+        cursor->block = FS_NO_BLOCK;
+    }
+    
+    // Bytes between the old end of file and `offset` read back as zero
+    unsigned int start = offset < file->size ? offset : file->size;
+    unsigned int end = offset + length;
+    
+    int have = fs_blocks_needed(file->size);
+    int need = fs_blocks_needed(end);
+    if (need > have) {
+        int extra = fs_alloc_chain(need - have);
+        if (extra == FS_NO_BLOCK) {
+            return 0;
+        }
+        
+        if (file->first_block == FS_NO_BLOCK) {
+            file->first_block = extra;
+        } else {
+            // Appended blocks aren't a chain head, so they carry no count
+            fs_block_refs[extra] = 0;
+            int tail = fs_cursor_seek(file, cursor, (have - 1) * FS_BLOCK_SIZE);
+            fs_block_next[tail] = extra;
+        }
+    }
+    
+    fs_cursor_seek(file, cursor, start);
+    unsigned int block_offset = start - cursor->start;
+    
+    unsigned int position = start;
+    while (position < end) {
+        if (block_offset == FS_BLOCK_SIZE) {
+            cursor->block = fs_block_next[cursor->block];
+            cursor->start += FS_BLOCK_SIZE;
+            block_offset = 0;
+        }
+        
+        unsigned int chunk = FS_BLOCK_SIZE - block_offset;
+        if (chunk > end - position) {
+            chunk = end - position;
+        }
+        
+        char* dest = fs_block_data[cursor->block] + block_offset;
+        if (position < offset) {
+            if (chunk > offset - position) {
+                chunk = offset - position;
+            }
+            memset(dest, 0, chunk);
+        } else {
+            memcpy(dest, data + (position - offset), chunk);
+        }
+        
+        position += chunk;
+        block_offset += chunk;
+    }
+    
+    if (end > file->size) {
+        file->size = end;
+    }
+    
+    return length;
+}
+
+unsigned int fs_write_data(fs_file_t* file, unsigned int offset, const char* data, unsigned int length) {
+    fs_cursor_t cursor = { FS_NO_BLOCK, 0 };
+    return fs_write_at(file, offset, data, length, &cursor);
+}
+
+void fs_map_file(const fs_file_t* file, fs_map_t* map) {
+    map->file = file;
+    map->offset = 0;
+    map->cursor.block = FS_NO_BLOCK;
+    map->cursor.start = 0;
+}
+
+// Start a view of the file at `name`, giving its size in `length`
+int fs_map(const char* name, unsigned int* length, fs_map_t* map) {
+    const fs_file_t* file = fs_find(name);
+    if (!file || file->type != FS_FILE) {
+        return 0;
+    }
+    
+    fs_map_file(file, map);
+    *length = file->size;
+    return 1;
+}
+
+// Point `span` at the next run of the file's bytes and return its length,
+// or 0 at the end of the file or on a read error
+unsigned int fs_map_next(fs_map_t* map, const char** span) {
+    const fs_file_t* file = map->file;
+    if (map->offset >= file->size) {
+        return 0;
+    }
+    
+    unsigned int length = file->size - map->offset;
+    if (file->volume != FS_VOLUME_RAM) {
+        const fs_volume_t* volume = fs_volumes[file->volume];
+        if (volume->map) {
+            *span = volume->map(file, map->offset, &length);
+        } else {
+            length = volume->read(file, map->offset, map->buffer, sizeof(map->buffer));
+            *span = map->buffer;
+        }
+    } else {
+        int block = fs_cursor_seek(file, &map->cursor, map->offset);
+        unsigned int block_offset = map->offset - map->cursor.start;
+        *span = fs_block_data[block] + block_offset;
+        
+        // Blocks handed out together usually sit next to each other
+        unsigned int run = FS_BLOCK_SIZE - block_offset;
+        while (run < length && fs_block_next[block] == block + 1) {
+            block++;
+            map->cursor.block = block;
+            map->cursor.start += FS_BLOCK_SIZE;
+            run += FS_BLOCK_SIZE;
+        }
+        if (length > run) {
+            length = run;
+        }
+    }
+    
+    map->offset += length;
+    return length;
+}
+
+// The tables come from the kernel heap on first use and are reused afterwards
+static void fs_free_tables(void) {
+    for (int i = 0; fs_files && i < fs_slot_count; i++) {
+        kfree(fs_files[i].sorted_children);
+    }
+    
+    kfree(fs_files);
+    kfree(fs_block_data);
+    kfree(fs_block_next);
+    kfree(fs_block_refs);
+    kfree(fs_hash_slots);
+    kfree(fs_hash_keys);
+    
+    fs_files = NULL;
+    fs_block_data = NULL;
+    fs_block_next = NULL;
+    fs_block_refs = NULL;
+    fs_hash_slots = NULL;
+    fs_hash_keys = NULL;
+}
+
+static int fs_alloc_tables(int max_files, int max_blocks) {
+    fs_free_tables();
+    
+    // Keep the path index at most half full
+    int hash_size = 1;
+    while (hash_size < max_files * 2) {
+        hash_size <<= 1;
+    }
+    
+    fs_files = kmalloc(max_files * sizeof(fs_file_t));
+    fs_block_data = kmalloc(max_blocks * FS_BLOCK_SIZE);
+    fs_block_next = kmalloc(max_blocks * sizeof(int));
+    fs_block_refs = kmalloc(max_blocks * sizeof(unsigned short));
+    fs_hash_slots = kmalloc(hash_size * sizeof(int));
+    fs_hash_keys = kmalloc(hash_size * sizeof(uint32_t));
+    
+    if (!fs_files || !fs_block_data || !fs_block_next || !fs_block_refs ||
+        !fs_hash_slots || !fs_hash_keys) {
+        fs_free_tables();
+        return 0;
+    }
+    
+    fs_max_files = max_files;
+    fs_max_blocks = max_blocks;
+    fs_hash_size = hash_size;
+    return 1;
+}
+
+// Split a memory budget between entries and data blocks, giving each
+// entry room for FS_BLOCKS_PER_FILE blocks of content
+void fs_capacity_for_memory(unsigned int budget, int* max_files, int* max_blocks) {
+    unsigned int per_file = sizeof(fs_file_t) + 2 * (sizeof(int) + sizeof(uint32_t)) +
+                            FS_BLOCKS_PER_FILE * (FS_BLOCK_SIZE + sizeof(int) + sizeof(unsigned short));
+    unsigned int files = budget / per_file;
+    
+    if (files < FS_MIN_FILES) {
+        files = FS_MIN_FILES;
+    } else if (files > FS_LIMIT_FILES) {
+        files = FS_LIMIT_FILES;
+    }
+    
+    *max_files = files;
+    *max_blocks = files * FS_BLOCKS_PER_FILE;
+}
+
+void fs_init(unsigned int budget) {
+    int max_files;
+    int max_blocks;
+    fs_capacity_for_memory(budget, &max_files, &max_blocks);
+    
+    // Back off if the heap can't hand out tables that large
+    while (!fs_alloc_tables(max_files, max_blocks)) {
+        if (max_files <= FS_MIN_FILES) {
+            return;
+        }
+        fs_capacity_for_memory(budget /= 2, &max_files, &max_blocks);
+    }
+    
+    fs_slot_count = 0;
+    fs_volume_count = 1;
+    fs_reset();
+}
+
+// Forget every entry, keeping the tables and any mounted volumes' state
+static void fs_clear(void) {
+    for (int i = 0; i < fs_slot_count; i++) {
+        kfree(fs_files[i].sorted_children);
+    }
+    fs_detach_handles(FS_NO_ENTRY);
+    
     fs_file_count = 0;
+    fs_slot_count = 0;
+    fs_free_entry_head = FS_NO_ENTRY;
+    fs_unloaded_dirs = 0;
     strcpy(fs_current_dir, "\\");
-    
+    fs_blocks_init(0);
+    fs_hash_clear();
+}
+
+static void fs_create_defaults(void) {
     fs_create_directory("\\");
     fs_create_directory("\\SYSTEM");
     fs_create_directory("\\DOCUMENTS");
@@ -47,30 +591,387 @@ void get_parent_dir(const char* path, char* parent) {
     }
 }
 
+// Index of the directory that would contain `name`, or FS_NO_ENTRY
+static int fs_parent_index(const char* name) {
+    char parent_dir[FS_MAX_FILENAME];
+    get_parent_dir(name, parent_dir);
+    
+    // If parent_dir is empty, that's an error
+    if (parent_dir[0] == '\0') {
+        return FS_NO_ENTRY;
+    }
+    
+    fs_file_t* parent = fs_find(parent_dir);
+    if (!parent || parent->type != FS_DIRECTORY) {
+        return FS_NO_ENTRY;
+    }
+    
+    return parent - fs_files;
+}
+
+// Append `child` to the end of `parent`'s child list so DIR keeps creation order
+static void fs_link_child(int parent, int child) {
+    fs_file_t* dir = &fs_files[parent];
+    fs_file_t* entry = &fs_files[child];
+    
+    entry->parent = parent;
+    entry->prev_sibling = dir->last_child;
+    entry->next_sibling = FS_NO_ENTRY;
+    
+    if (dir->last_child != FS_NO_ENTRY) {
+        fs_files[dir->last_child].next_sibling = child;
+    } else {
+        dir->first_child = child;
+    }
+    dir->last_child = child;
+    dir->child_count++;
+    dir->sorted_valid = 0;
+}
+
+static void fs_unlink_child(int child) {
+    fs_file_t* entry = &fs_files[child];
+    if (entry->parent == FS_NO_ENTRY) {
+        return;
+    }
+    
+    fs_file_t* dir = &fs_files[entry->parent];
+    
+    if (entry->prev_sibling != FS_NO_ENTRY) {
+        fs_files[entry->prev_sibling].next_sibling = entry->next_sibling;
+    } else {
+        dir->first_child = entry->next_sibling;
+    }
+    
+    if (entry->next_sibling != FS_NO_ENTRY) {
+        fs_files[entry->next_sibling].prev_sibling = entry->prev_sibling;
+    } else {
+        dir->last_child = entry->prev_sibling;
+    }
+    
+    dir->child_count--;
+    dir->sorted_valid = 0;
+    entry->parent = FS_NO_ENTRY;
+    entry->prev_sibling = FS_NO_ENTRY;
+    entry->next_sibling = FS_NO_ENTRY;
+}
+
+// Claim a table slot, index it and hook it under its parent
+static int fs_add_entry(const char* name, unsigned char type, int parent) {
+    int index;
+    if (fs_free_entry_head != FS_NO_ENTRY) {
+        index = fs_free_entry_head;
+        fs_free_entry_head = fs_files[index].next_sibling;
+    } else {
+        index = fs_slot_count++;
+    }
+    fs_file_count++;
+    
+    fs_file_t* entry = &fs_files[index];
+    
+    strcpy(entry->name, name);
+    entry->type = type;
+    entry->size = 0;
+    entry->first_block = FS_NO_BLOCK;
+    entry->parent = FS_NO_ENTRY;
+    entry->first_child = FS_NO_ENTRY;
+    entry->last_child = FS_NO_ENTRY;
+    entry->prev_sibling = FS_NO_ENTRY;
+    entry->next_sibling = FS_NO_ENTRY;
+    entry->child_count = 0;
+    entry->sorted_children = NULL;
+    entry->sorted_capacity = 0;
+    entry->sorted_valid = 0;
+    entry->volume = parent != FS_NO_ENTRY ? fs_files[parent].volume : FS_VOLUME_RAM;
+    entry->loaded = 1;
+    entry->location = 0;
+    entry->record = 0;
+    
+    fs_hash_insert(index);
+    if (parent != FS_NO_ENTRY) {
+        fs_link_child(parent, index);
+    }
+    
+    return index;
+}
+
+// Undo fs_add_entry(): unindex, unlink and put the slot on the free list.
+// `slot` is the entry's place in the path index if the caller has it, or -1.
+static void fs_remove_entry(int index, int slot) {
+    fs_file_t* entry = &fs_files[index];
+    
+    if (!entry->loaded) {
+        fs_unloaded_dirs--;
+    }
+    
+    fs_detach_handles(index);
+    fs_release_chain(entry->first_block);
+    fs_unlink_child(index);
+    if (slot >= 0) {
+        fs_hash_remove_slot(slot);
+    } else {
+        fs_hash_remove(entry->name);
+    }
+    
+    kfree(entry->sorted_children);
+    entry->sorted_children = NULL;
+    entry->sorted_capacity = 0;
+    
+    // No other entry moves
+    entry->type = FS_FREE;
+    entry->name[0] = '\0';
+    entry->next_sibling = fs_free_entry_head;
+    fs_free_entry_head = index;
+    fs_file_count--;
+    
+    fs_hash_compact();
+}
+
+// Let a mounted volume veto or record a new entry before it is used
+static int fs_volume_create(int index) {
+    fs_file_t* entry = &fs_files[index];
+    if (entry->volume == FS_VOLUME_RAM) {
+        return 1;
+    }
+    
+    const fs_volume_t* volume = fs_volumes[entry->volume];
+    if (!volume->create || !volume->create(entry)) {
+        fs_remove_entry(index, -1);
+        return 0;
+    }
+    return 1;
+}
+
+// Read a mounted directory's entries into the table if that hasn't happened yet
+static int fs_load_directory(fs_file_t* dir) {
+    if (dir->loaded) {
+        return 1;
+    }
+    
+    if (!fs_volumes[dir->volume]->load(dir)) {
+        return 0;
+    }
+    
+    dir->loaded = 1;
+    fs_unloaded_dirs--;
+    return 1;
+}
+
+// Make `path` the root directory of a registered volume
+static int fs_attach(const char* path, int volume, uint32_t location) {
+    if (!fs_create_directory(path)) {
+        return 0;
+    }
+    
+    fs_file_t* root = fs_find(path);
+    root->volume = volume;
+    root->location = location;
+    root->loaded = 0;
+    fs_unloaded_dirs++;
+    return 1;
+}
+
+// Attach a volume at `path`, which must not exist yet. Nothing is read
+// until the directory is first used.
+int fs_mount(const char* path, const fs_volume_t* volume, uint32_t location) {
+    if (fs_volume_count == FS_MAX_VOLUMES || !fs_attach(path, fs_volume_count, location)) {
+        return 0;
+    }
+    
+    fs_volumes[fs_volume_count++] = volume;
+    return 1;
+}
+
+// Called by a volume's load hook for each entry it finds in `dir`.
+// Entries that are already there or whose path would be too long are
+// skipped. Subdirectories wait to be loaded in turn.
+fs_file_t* fs_add_loaded(fs_file_t* dir, const char* name, unsigned char type, unsigned int size,
+                         uint32_t location, uint32_t record) {
+    char path[FS_MAX_FILENAME];
+    int dir_length = strlen(dir->name);
+    int separator = dir->name[dir_length - 1] != '\\';
+    
+    if (fs_file_count >= fs_max_files || dir_length + separator + strlen(name) >= FS_MAX_FILENAME) {
+        return 0;
+    }
+    
+    strcpy(path, dir->name);
+    if (separator) {
+        strcat(path, "\\");
+    }
+    strcat(path, name);
+    if (fs_hash_find_slot(path, fs_hash_path(path)) >= 0) {
+        return 0;
+    }
+    
+    fs_file_t* entry = &fs_files[fs_add_entry(path, type, dir - fs_files)];
+    entry->size = size;
+    entry->location = location;
+    entry->record = record;
+    if (type == FS_DIRECTORY) {
+        entry->loaded = 0;
+        fs_unloaded_dirs++;
+    }
+    return entry;
+}
+
+// A mount point belongs to its volume but sits in a directory of another one
+static int fs_is_mount_point(const fs_file_t* entry) {
+    return entry->volume != FS_VOLUME_RAM &&
+        (entry->parent == FS_NO_ENTRY || fs_files[entry->parent].volume != entry->volume);
+}
+
 int fs_create_file(const char* name, const char* content) {
     // Check if we have space for more files
-    if (fs_file_count >= FS_MAX_FILES) {
+    if (fs_file_count >= fs_max_files) {
+        return 0;
+    }
+    
+    // Check if file already exists
+    if (fs_find(name) != 0) {
+        return 0;
+    }
+    
+    // Files have to live in an existing directory
+    int parent = fs_parent_index(name);
+    if (parent == FS_NO_ENTRY) {
+        return 0;
+    }
+    
+    // Make sure the content fits before creating the entry
+    unsigned int size = strlen(content);
+    if (fs_files[parent].volume == FS_VOLUME_RAM && fs_blocks_needed(size) > fs_free_block_count) {
+        return 0;
+    }
+    
+    // Create the new file
+    int index = fs_add_entry(name, FS_FILE, parent);
+    if (!fs_volume_create(index)) {
+        return 0;
+    }
+    
+    // Don't leave a truncated file behind, in the table or on the volume
+    if (size > 0 && fs_write_data(&fs_files[index], 0, content, size) != size) {
+        fs_delete(name);
+        return 0;
+    }
+    return 1;
+}
+
+// Open a file for reading and/or writing, returning a handle or
+// FS_NO_HANDLE. The position starts at 0.
+int fs_open(const char* name, int mode) {
+    if (!(mode & (FS_OPEN_READ | FS_OPEN_WRITE))) {
+        return FS_NO_HANDLE;
+    }
+    
+    int handle = 0;
+    while (handle < FS_MAX_HANDLES && fs_handles[handle].open) {
+        handle++;
+    }
+    if (handle == FS_MAX_HANDLES) {
+        return FS_NO_HANDLE;
+    }
+    
+    fs_file_t* file = fs_find(name);
+    if (!file && (mode & FS_OPEN_CREATE) && fs_create_file(name, "")) {
+        file = fs_find(name);
+    }
+    if (!file || file->type != FS_FILE) {
+        return FS_NO_HANDLE;
+    }
+    
+    fs_handles[handle].open = 1;
+    fs_handles[handle].file = file - fs_files;
+    fs_handles[handle].mode = mode;
+    fs_handles[handle].position = 0;
+    fs_handles[handle].cursor.block = FS_NO_BLOCK;
+    fs_handles[handle].cursor.start = 0;
+    return handle;
+}
+
+// The open handle's file, or NULL if it has been deleted since
+static fs_file_t* fs_handle_file(int handle) {
+    if (handle < 0 || handle >= FS_MAX_HANDLES || !fs_handles[handle].open ||
+        fs_handles[handle].file == FS_NO_ENTRY) {
+        return NULL;
+    }
+    return &fs_files[fs_handles[handle].file];
+}
+
+unsigned int fs_read(int handle, void* buffer, unsigned int length) {
+    fs_file_t* file = fs_handle_file(handle);
+    if (!file || !(fs_handles[handle].mode & FS_OPEN_READ)) {
+        return 0;
+    }
+    
+    fs_handle_t* state = &fs_handles[handle];
+    unsigned int count = fs_read_at(file, state->position, buffer, length, &state->cursor);
+    state->position += count;
+    return count;
+}
+
+// Writes at the position, or at the end of the file with FS_OPEN_APPEND.
+// Only the blocks written to are touched.
+unsigned int fs_write(int handle, const void* data, unsigned int length) {
+    fs_file_t* file = fs_handle_file(handle);
+    if (!file || !(fs_handles[handle].mode & FS_OPEN_WRITE)) {
+        return 0;
+    }
+    
+    fs_handle_t* state = &fs_handles[handle];
+    if (state->mode & FS_OPEN_APPEND) {
+        state->position = file->size;
+    }
+    
+    unsigned int written = fs_write_at(file, state->position, data, length, &state->cursor);
+    state->position += written;
+    return written;
+}
+
+// Move the position relative to FS_SEEK_SET, FS_SEEK_CUR or FS_SEEK_END.
+// Seeking past the end is allowed; a write there fills the gap with zeroes.
+int fs_seek(int handle, int offset, int whence) {
+    fs_file_t* file = fs_handle_file(handle);
+    if (!file) {
+        return 0;
+    }
+    
+    unsigned int base;
+    if (whence == FS_SEEK_SET) {
+        base = 0;
+    } else if (whence == FS_SEEK_CUR) {
+        base = fs_handles[handle].position;
+    } else if (whence == FS_SEEK_END) {
+        base = file->size;
+    } else {
+        return 0;
+    }
+    
+    // -(offset + 1) can't overflow, even for INT_MIN
+    if (offset < 0 ? (unsigned int)-(offset + 1) >= base : base + offset < base) {
         return 0;
     }
-    
-    // Check if file already exists
-    if (fs_find(name) != 0) {
+    fs_handles[handle].position = base + offset;
+    return 1;
+}
+
+unsigned int fs_tell(int handle) {
+    return fs_handle_file(handle) ? fs_handles[handle].position : 0;
+}
+
+int fs_close(int handle) {
+    if (handle < 0 || handle >= FS_MAX_HANDLES || !fs_handles[handle].open) {
         return 0;
     }
     
-    // Create the new file
-    strcpy(fs_files[fs_file_count].name, name);
-    fs_files[fs_file_count].type = FS_FILE;
-    fs_files[fs_file_count].size = strlen(content);
-    strcpy(fs_files[fs_file_count].content, content);
-    fs_file_count++;
-    
+    fs_handles[handle].open = 0;
+    fs_handles[handle].file = FS_NO_ENTRY;
     return 1;
 }
 
 int fs_create_directory(const char* name) {
     // Check if we have space for more files
-    if (fs_file_count >= FS_MAX_FILES) {
+    if (fs_file_count >= fs_max_files) {
         return 0;
     }
     
@@ -80,65 +981,165 @@ int fs_create_directory(const char* name) {
     }
     
     // If it's not the root directory, check if parent directory exists
+    int parent = FS_NO_ENTRY;
     if (strcmp(name, "\\") != 0) {
-        char parent_dir[FS_MAX_FILENAME];
-        get_parent_dir(name, parent_dir);
-        
-        // If parent_dir is empty, that's an error
-        if (parent_dir[0] == '\0') {
-            return 0;
-        }
-        
-        // Find the parent directory
-        fs_file_t* parent = fs_find(parent_dir);
-        if (!parent || parent->type != FS_DIRECTORY) {
+        parent = fs_parent_index(name);
+        if (parent == FS_NO_ENTRY) {
             return 0;  // Parent directory doesn't exist
         }
     }
     
-    strcpy(fs_files[fs_file_count].name, name);
-    fs_files[fs_file_count].type = FS_DIRECTORY;
-    fs_files[fs_file_count].size = 0;
-    fs_files[fs_file_count].content[0] = '\0';
-    fs_file_count++;
+    int index = fs_add_entry(name, FS_DIRECTORY, parent);
+    return fs_volume_create(index);
+}
+
+int fs_delete(const char* name) {
+    // Find the file or directory, keeping its index slot for the removal
+    int slot = fs_hash_find_slot(name, fs_hash_path(name));
+    fs_file_t* entry = slot >= 0 ? &fs_files[fs_hash_slots[slot]] : fs_find(name);
+    if (!entry || fs_is_mount_point(entry)) {
+        return 0;
+    }
+    
+    // Removing a directory with children would orphan them
+    if (!fs_load_directory(entry) || entry->child_count > 0) {
+        return 0;
+    }
     
+    if (entry->volume != FS_VOLUME_RAM) {
+        const fs_volume_t* volume = fs_volumes[entry->volume];
+        if (!volume->remove || !volume->remove(entry)) {
+            return 0;
+        }
+    }
+    
+    fs_remove_entry(entry - fs_files, slot);
     return 1;
 }
 
-int fs_delete(const char* name) {
-    // Find the file or directory
-    int i;
-    for (i = 0; i < fs_file_count; i++) {
-        if (strcmp(fs_files[i].name, name) == 0) {
-            // Found the file/directory to delete
-            // Move all items after this one up to fill the gap
-            for (int j = i; j < fs_file_count - 1; j++) {
-                strcpy(fs_files[j].name, fs_files[j+1].name);
-                fs_files[j].type = fs_files[j+1].type;
-                fs_files[j].size = fs_files[j+1].size;
-                strcpy(fs_files[j].content, fs_files[j+1].content);
-            }
-            fs_file_count--;
-            return 1;
+// Check that every path in the subtree still fits once its prefix grows by `growth`
+static int fs_subtree_fits(int index, int growth) {
+    if (strlen(fs_files[index].name) + growth >= FS_MAX_FILENAME) {
+        return 0;
+    }
+    
+    for (int child = fs_files[index].first_child; child != FS_NO_ENTRY; child = fs_files[child].next_sibling) {
+        if (!fs_subtree_fits(child, growth)) {
+            return 0;
         }
     }
     
-    return 0;
+    return 1;
 }
 
-int fs_rename(const char* oldname, const char* newname) {
+// Swap the first `old_length` characters of every path in the subtree for `prefix`
+static void fs_subtree_rename(int index, const char* prefix, int old_length) {
+    fs_file_t* entry = &fs_files[index];
+    char new_path[FS_MAX_FILENAME];
+    
+    strcpy(new_path, prefix);
+    strcat(new_path, entry->name + old_length);
+    
+    fs_hash_remove(entry->name);
+    strcpy(entry->name, new_path);
+    fs_hash_insert(index);
+    
+    for (int child = entry->first_child; child != FS_NO_ENTRY; child = fs_files[child].next_sibling) {
+        fs_subtree_rename(child, prefix, old_length);
+    }
+}
+
+// Give an entry a new path, moving it between directories if needed. Only
+// names and links change; file data stays where it is.
+static int fs_relink(const char* oldname, const char* newname) {
     // Check if the new name already exists
     if (fs_find(newname) != 0) {
-        return 0; 
+        return 0;
     }
     
-    // Find the file to rename
     fs_file_t* file = fs_find(oldname);
-    if (!file) {
+    if (!file || file->parent == FS_NO_ENTRY) {
+        return 0;
+    }
+    
+    // The new name may put the entry in a different directory
+    int parent = fs_parent_index(newname);
+    if (parent == FS_NO_ENTRY) {
+        return 0;
+    }
+    
+    // A directory can't be moved underneath itself
+    int index = file - fs_files;
+    for (int dir = parent; dir != FS_NO_ENTRY; dir = fs_files[dir].parent) {
+        if (dir == index) {
+            return 0;
+        }
+    }
+    
+    int old_length = strlen(oldname);
+    if (!fs_subtree_fits(index, strlen(newname) - old_length)) {
+        return 0;
+    }
+    
+    // Entries can't change volume, and the volume gets the last word
+    if (fs_is_mount_point(file) || fs_files[parent].volume != file->volume) {
+        return 0;
+    }
+    if (file->volume != FS_VOLUME_RAM) {
+        const fs_volume_t* volume = fs_volumes[file->volume];
+        const char* new_name = strrchr(newname, '\\') + 1;
+        if (!volume->rename || !volume->rename(file, &fs_files[parent], new_name)) {
+            return 0;
+        }
+    }
+    
+    if (parent != file->parent) {
+        fs_unlink_child(index);
+        fs_link_child(parent, index);
+    } else {
+        fs_files[parent].sorted_valid = 0;
+    }
+    
+    // Keep the shell inside a directory that just moved
+    int in_subtree = strncmp(fs_current_dir, oldname, old_length) == 0 &&
+        (fs_current_dir[old_length] == '\0' || fs_current_dir[old_length] == '\\');
+    if (in_subtree) {
+        char new_current[FS_MAX_FILENAME];
+        strcpy(new_current, newname);
+        strcat(new_current, fs_current_dir + old_length);
+        strcpy(fs_current_dir, new_current);
+    }
+    
+    fs_subtree_rename(index, newname, old_length);
+    fs_hash_compact();
+    return 1;
+}
+
+int fs_rename(const char* oldname, const char* newname) {
+    return fs_relink(oldname, newname);
+}
+
+// Copy span by span when either side is a mounted volume
+static int fs_copy_data(const fs_file_t* src_file, const char* dest) {
+    if (!fs_create_file(dest, "")) {
         return 0;
     }
     
-    strcpy(file->name, newname);
+    fs_file_t* dest_file = fs_find(dest);
+    fs_cursor_t cursor = { FS_NO_BLOCK, 0 };
+    fs_map_t map;
+    fs_map_file(src_file, &map);
+    
+    const char* span;
+    for (unsigned int offset = 0; offset < src_file->size; ) {
+        unsigned int length = fs_map_next(&map, &span);
+        if (length == 0 || fs_write_at(dest_file, offset, span, length, &cursor) != length) {
+            fs_delete(dest);
+            return 0;
+        }
+        offset += length;
+    }
+    
     return 1;
 }
 
@@ -149,31 +1150,229 @@ int fs_copy(const char* source, const char* dest) {
         return 0;
     }
     
-    return fs_create_file(dest, src_file->content);
+    if (fs_file_count >= fs_max_files || fs_find(dest) != 0) {
+        return 0;
+    }
+    
+    int parent = fs_parent_index(dest);
+    if (parent == FS_NO_ENTRY) {
+        return 0;
+    }
+    
+    if (src_file->volume != FS_VOLUME_RAM || fs_files[parent].volume != FS_VOLUME_RAM) {
+        return fs_copy_data(src_file, dest);
+    }
+    
+    // Share the source's chain; whichever file is written first copies it
+    int index = fs_add_entry(dest, FS_FILE, parent);
+    fs_files[index].size = src_file->size;
+    fs_files[index].first_block = src_file->first_block;
+    if (src_file->first_block != FS_NO_BLOCK) {
+        fs_block_refs[src_file->first_block]++;
+    }
+    
+    return 1;
 }
 
+// Moves within a volume relink instead of copying data. Files moving to
+// another volume are copied over and then deleted.
 int fs_move(const char* source, const char* dest) {
-    // First copy the file
-    if (!fs_copy(source, dest)) {
+    fs_file_t* file = fs_find(source);
+    int parent = fs_parent_index(dest);
+    
+    if (file && file->type == FS_FILE && parent != FS_NO_ENTRY && fs_files[parent].volume != file->volume) {
+        // Don't copy what can't be removed afterwards, and take the copy
+        // back if removing still fails, so a failed move changes nothing
+        if (fs_is_mount_point(file) ||
+            (file->volume != FS_VOLUME_RAM && !fs_volumes[file->volume]->remove)) {
+            return 0;
+        }
+        if (!fs_copy(source, dest)) {
+            return 0;
+        }
+        if (!fs_delete(source)) {
+            fs_delete(dest);
+            return 0;
+        }
+        return 1;
+    }
+    return fs_relink(source, dest);
+}
+
+// A path missing from the index may sit in a directory that hasn't been
+// loaded yet. Find its parent the same way, load it and look again.
+static fs_file_t* fs_find_unloaded(const char* name) {
+    char parent_dir[FS_MAX_FILENAME];
+    get_parent_dir(name, parent_dir);
+    if (parent_dir[0] == '\0' || strcmp(parent_dir, name) == 0) {
         return 0;
     }
     
-    return fs_delete(source);
+    fs_file_t* dir = fs_find(parent_dir);
+    if (!dir || dir->type != FS_DIRECTORY || dir->loaded || !fs_load_directory(dir)) {
+        return 0;
+    }
+    
+    int slot = fs_hash_find_slot(name, fs_hash_path(name));
+    return slot < 0 ? 0 : &fs_files[fs_hash_slots[slot]];
 }
 
 fs_file_t* fs_find(const char* name) {
-    for (int i = 0; i < fs_file_count; i++) {
-        if (strcmp(fs_files[i].name, name) == 0) {
-            return &fs_files[i];
+    int slot = fs_hash_find_slot(name, fs_hash_path(name));
+    if (slot < 0) {
+        return fs_unloaded_dirs > 0 ? fs_find_unloaded(name) : 0;
+    }
+    return &fs_files[fs_hash_slots[slot]];
+}
+
+fs_file_t* fs_first_child(fs_file_t* dir) {
+    if (!fs_load_directory(dir) || dir->first_child == FS_NO_ENTRY) {
+        return 0;
+    }
+    return &fs_files[dir->first_child];
+}
+
+fs_file_t* fs_next_child(const fs_file_t* entry) {
+    if (entry->next_sibling == FS_NO_ENTRY) {
+        return 0;
+    }
+    return &fs_files[entry->next_sibling];
+}
+
+fs_file_t* fs_parent(const fs_file_t* entry) {
+    if (entry->parent == FS_NO_ENTRY) {
+        return 0;
+    }
+    return &fs_files[entry->parent];
+}
+
+// The last path component of an entry, "" for the root directory
+const char* fs_basename(const fs_file_t* entry) {
+    const char* last_slash = strrchr(entry->name, '\\');
+    if (last_slash) {
+        return last_slash + 1;
+    }
+    return entry->name;
+}
+
+// Directories sort their children by basename only when a prefix lookup
+// asks, so creating and renaming stay O(1). Any change to the child list
+// marks the order stale.
+
+static int fs_sorted_before(int a, int b) {
+    return strcmp(fs_basename(&fs_files[a]), fs_basename(&fs_files[b])) < 0;
+}
+
+static void fs_sorted_sift(int* heap, int root, int count) {
+    while (2 * root + 1 < count) {
+        int child = 2 * root + 1;
+        if (child + 1 < count && fs_sorted_before(heap[child], heap[child + 1])) {
+            child++;
+        }
+        if (!fs_sorted_before(heap[root], heap[child])) {
+            return;
+        }
+        
+        int swap = heap[root];
+        heap[root] = heap[child];
+        heap[child] = swap;
+        root = child;
+    }
+}
+
+static int fs_sort_children(fs_file_t* dir) {
+    int count = dir->child_count;
+    
+    if (count > dir->sorted_capacity) {
+        int capacity = dir->sorted_capacity ? dir->sorted_capacity : FS_SORTED_MIN_CAPACITY;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        
+        int* sorted = kmalloc(capacity * sizeof(int));
+        if (!sorted) {
+            return 0;
+        }
+        kfree(dir->sorted_children);
+        dir->sorted_children = sorted;
+        dir->sorted_capacity = capacity;
+    }
+    
+    int* sorted = dir->sorted_children;
+    int n = 0;
+    for (int child = dir->first_child; child != FS_NO_ENTRY; child = fs_files[child].next_sibling) {
+        sorted[n++] = child;
+    }
+    
+    // Heapsort: no recursion and no scratch memory
+    for (int root = count / 2 - 1; root >= 0; root--) {
+        fs_sorted_sift(sorted, root, count);
+    }
+    for (int end = count - 1; end > 0; end--) {
+        int swap = sorted[0];
+        sorted[0] = sorted[end];
+        sorted[end] = swap;
+        fs_sorted_sift(sorted, 0, end);
+    }
+    
+    dir->sorted_valid = 1;
+    return 1;
+}
+
+// Find the children of `dir` whose basename starts with `prefix` by binary
+// search. Returns how many there are and stores the sorted position of the
+// first one for fs_sorted_child().
+int fs_prefix_range(fs_file_t* dir, const char* prefix, int* first) {
+    *first = 0;
+    if (dir->type != FS_DIRECTORY || !fs_load_directory(dir) || dir->child_count == 0) {
+        return 0;
+    }
+    if (!dir->sorted_valid && !fs_sort_children(dir)) {
+        return 0;
+    }
+    
+    int length = strlen(prefix);
+    int low = 0;
+    int high = dir->child_count;
+    
+    // First name not less than the prefix
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (strcmp(fs_basename(&fs_files[dir->sorted_children[middle]]), prefix) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
         }
     }
-    return 0;
+    
+    // Everything from there on is >= prefix, so the matches come first
+    int start = low;
+    high = dir->child_count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (strncmp(fs_basename(&fs_files[dir->sorted_children[middle]]), prefix, length) == 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    
+    *first = start;
+    return low - start;
+}
+
+// Only meaningful right after fs_prefix_range() on the same directory
+fs_file_t* fs_sorted_child(const fs_file_t* dir, int position) {
+    if (position < 0 || position >= dir->child_count) {
+        return 0;
+    }
+    return &fs_files[dir->sorted_children[position]];
 }
 
 void fs_list_directory(void) {
-    for (int i = 0; i < fs_file_count; i++) {
-        // Skip the root directory entry
-        if (strcmp(fs_files[i].name, "\\") == 0) {
+    for (int i = 0; i < fs_slot_count; i++) {
+        // Skip free slots and the root directory entry
+        if (fs_files[i].type == FS_FREE || strcmp(fs_files[i].name, "\\") == 0) {
             continue;
         }
         
@@ -185,4 +1384,280 @@ void fs_list_directory(void) {
             // It's a file
         }
     }
-}
\ No newline at end of file
+}
+
+// Mount points to put back after the table has been replaced
+typedef struct {
+    char path[FS_MAX_FILENAME];
+    int volume;
+    uint32_t location;
+} fs_mount_point_t;
+
+static int fs_save_mounts(fs_mount_point_t* mounts) {
+    int count = 0;
+    for (int i = 0; i < fs_slot_count && count < FS_MAX_VOLUMES; i++) {
+        if (fs_files[i].type != FS_FREE && fs_is_mount_point(&fs_files[i])) {
+            strcpy(mounts[count].path, fs_files[i].name);
+            mounts[count].volume = fs_files[i].volume;
+            mounts[count].location = fs_files[i].location;
+            count++;
+        }
+    }
+    return count;
+}
+
+// A mount point whose path is now taken by a RAM entry stays detached
+static void fs_restore_mounts(const fs_mount_point_t* mounts, int count) {
+    for (int i = 0; i < count; i++) {
+        fs_attach(mounts[i].path, mounts[i].volume, mounts[i].location);
+    }
+}
+
+// Back to the default tree; mounted volumes stay where they were
+void fs_reset(void) {
+    fs_mount_point_t mounts[FS_MAX_VOLUMES];
+    int mount_count = fs_save_mounts(mounts);
+    
+    fs_clear();
+    fs_create_defaults();
+    fs_restore_mounts(mounts, mount_count);
+}
+
+// Counts for a snapshot of the tables as they are now
+int fs_snapshot_prepare(fs_snapshot_info_t* info) {
+    if (!fs_files) {
+        return 0;
+    }
+    
+    info->slot_count = fs_slot_count;
+    info->file_count = fs_file_count;
+    info->free_entry_head = fs_free_entry_head;
+    info->block_count = fs_max_blocks - fs_free_block_count;
+    info->hash_size = fs_hash_size;
+    info->hash_tombstones = fs_hash_tombstones;
+    return 1;
+}
+
+// The payload is the entry table, the used blocks' links, reference counts
+// and data, then the path index, each copied as it sits in memory
+uint32_t fs_snapshot_size(const fs_snapshot_info_t* info) {
+    return info->slot_count * sizeof(fs_file_t) +
+           info->block_count * (sizeof(int) + sizeof(unsigned short) + FS_BLOCK_SIZE) +
+           info->hash_size * (sizeof(int) + sizeof(uint32_t));
+}
+
+// Skip over mount points in a RAM directory's child list
+static int fs_snapshot_sibling(int index, int forward) {
+    while (index != FS_NO_ENTRY && fs_files[index].volume != FS_VOLUME_RAM) {
+        index = forward ? fs_files[index].next_sibling : fs_files[index].prev_sibling;
+    }
+    return index;
+}
+
+static int fs_snapshot_save_entries(fs_snapshot_info_t* info, const int* renumber, fs_snapshot_io_t write) {
+    for (int i = 0; i < fs_slot_count; i++) {
+        fs_file_t entry = fs_files[i];
+        entry.sorted_children = NULL;
+        entry.sorted_capacity = 0;
+        entry.sorted_valid = 0;
+        
+        if (entry.type != FS_FREE && entry.volume != FS_VOLUME_RAM) {
+            // Mounted volumes are left out; their slots go on the free list
+            entry.type = FS_FREE;
+            entry.name[0] = '\0';
+            entry.next_sibling = info->free_entry_head;
+            info->free_entry_head = i;
+            info->file_count--;
+        } else if (entry.type != FS_FREE) {
+            if (entry.first_block != FS_NO_BLOCK) {
+                entry.first_block = renumber[entry.first_block];
+            }
+            entry.prev_sibling = fs_snapshot_sibling(entry.prev_sibling, 0);
+            entry.next_sibling = fs_snapshot_sibling(entry.next_sibling, 1);
+            
+            if (entry.type == FS_DIRECTORY) {
+                entry.first_child = fs_snapshot_sibling(entry.first_child, 1);
+                entry.last_child = fs_snapshot_sibling(entry.last_child, 0);
+                for (int child = fs_files[i].first_child; child != FS_NO_ENTRY; child = fs_files[child].next_sibling) {
+                    if (fs_files[child].volume != FS_VOLUME_RAM) {
+                        entry.child_count--;
+                    }
+                }
+            }
+        }
+        
+        if (!write(&entry, sizeof(entry))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Chains are stored back to back in the order their first owner appears
+static int fs_snapshot_save_blocks(const int* renumber, fs_snapshot_io_t write) {
+    int stored = 0;
+    for (int i = 0; i < fs_slot_count; i++) {
+        int head = fs_files[i].first_block;
+        if (fs_files[i].type != FS_FILE || head == FS_NO_BLOCK || renumber[head] != stored) {
+            continue;
+        }
+        
+        for (int block = head; block != FS_NO_BLOCK; block = fs_block_next[block]) {
+            int next = fs_block_next[block] != FS_NO_BLOCK ? stored + 1 : FS_NO_BLOCK;
+            if (!write(&next, sizeof(next))) {
+                return 0;
+            }
+            stored++;
+        }
+    }
+    
+    stored = 0;
+    for (int i = 0; i < fs_slot_count; i++) {
+        int head = fs_files[i].first_block;
+        if (fs_files[i].type != FS_FILE || head == FS_NO_BLOCK || renumber[head] != stored) {
+            continue;
+        }
+        
+        for (int block = head; block != FS_NO_BLOCK; block = fs_block_next[block]) {
+            unsigned short refs = block == head ? fs_block_refs[head] : 0;
+            if (!write(&refs, sizeof(refs))) {
+                return 0;
+            }
+            stored++;
+        }
+    }
+    
+    stored = 0;
+    for (int i = 0; i < fs_slot_count; i++) {
+        int head = fs_files[i].first_block;
+        if (fs_files[i].type != FS_FILE || head == FS_NO_BLOCK || renumber[head] != stored) {
+            continue;
+        }
+        
+        // Blocks handed out together usually sit next to each other
+        int run = head;
+        int length = 0;
+        for (int block = head; block != FS_NO_BLOCK; block = fs_block_next[block]) {
+            if (block != run + length) {
+                if (!write(fs_block_data[run], length * FS_BLOCK_SIZE)) {
+                    return 0;
+                }
+                run = block;
+                length = 0;
+            }
+            length++;
+            stored++;
+        }
+        if (!write(fs_block_data[run], length * FS_BLOCK_SIZE)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int fs_snapshot_save_index(fs_snapshot_info_t* info, fs_snapshot_io_t write) {
+    int slots[FS_BLOCK_SIZE / sizeof(int)];
+    int count = sizeof(slots) / sizeof(slots[0]);
+    
+    for (int first = 0; first < fs_hash_size; first += count) {
+        if (fs_hash_size - first < count) {
+            count = fs_hash_size - first;
+        }
+        for (int i = 0; i < count; i++) {
+            slots[i] = fs_hash_slots[first + i];
+            if (slots[i] >= 0 && fs_files[slots[i]].volume != FS_VOLUME_RAM) {
+                slots[i] = FS_HASH_DELETED;
+                info->hash_tombstones++;
+            }
+        }
+        if (!write(slots, count * sizeof(int))) {
+            return 0;
+        }
+    }
+    return write(fs_hash_keys, fs_hash_size * sizeof(uint32_t));
+}
+
+// Stream a payload laid out as fs_snapshot_prepare() described, finishing
+// the counts in `info` that leaving out mounted volumes changes
+int fs_snapshot_save(fs_snapshot_info_t* info, fs_snapshot_io_t write) {
+    int* renumber = kmalloc(fs_max_blocks * sizeof(int));
+    if (!renumber) {
+        return 0;
+    }
+    
+    // Number the blocks in the order they will be written
+    int stored = 0;
+    for (int i = 0; i < fs_max_blocks; i++) {
+        renumber[i] = FS_NO_BLOCK;
+    }
+    for (int i = 0; i < fs_slot_count; i++) {
+        int head = fs_files[i].first_block;
+        if (fs_files[i].type != FS_FILE || head == FS_NO_BLOCK || renumber[head] != FS_NO_BLOCK) {
+            continue;
+        }
+        
+        renumber[head] = stored;
+        for (int block = head; block != FS_NO_BLOCK; block = fs_block_next[block]) {
+            stored++;
+        }
+    }
+    
+    int ok = stored == info->block_count &&
+             fs_snapshot_save_entries(info, renumber, write) &&
+             fs_snapshot_save_blocks(renumber, write) &&
+             fs_snapshot_save_index(info, write);
+    kfree(renumber);
+    return ok;
+}
+
+// Whether a snapshot taken with other table sizes still fits in these
+int fs_snapshot_fits(const fs_snapshot_info_t* info) {
+    return fs_files && info->slot_count > 0 && info->slot_count <= fs_max_files &&
+           info->file_count <= info->slot_count && info->block_count >= 0 &&
+           info->block_count <= fs_max_blocks && info->hash_size > 0 &&
+           info->hash_size <= FS_LIMIT_FILES * 4;
+}
+
+// Read a payload straight into the tables. The path index is kept as is
+// when the table sizes match and rebuilt otherwise. Mounted volumes come
+// back at their old paths. If `read` fails, which is also how a bad
+// checksum shows up, the default tree is put back instead.
+int fs_snapshot_restore(const fs_snapshot_info_t* info, fs_snapshot_io_t read) {
+    fs_mount_point_t mounts[FS_MAX_VOLUMES];
+    int mount_count = fs_save_mounts(mounts);
+    fs_clear();
+    
+    int ok = read(fs_files, info->slot_count * sizeof(fs_file_t)) &&
+             read(fs_block_next, info->block_count * sizeof(int)) &&
+             read(fs_block_refs, info->block_count * sizeof(unsigned short)) &&
+             read(fs_block_data, info->block_count * FS_BLOCK_SIZE);
+    
+    int keep_index = info->hash_size == fs_hash_size;
+    if (ok && keep_index) {
+        ok = read(fs_hash_slots, fs_hash_size * sizeof(int)) &&
+             read(fs_hash_keys, fs_hash_size * sizeof(uint32_t));
+    } else if (ok) {
+        ok = read(NULL, info->hash_size * (sizeof(int) + sizeof(uint32_t)));
+    }
+    
+    if (!ok) {
+        fs_clear();
+        fs_create_defaults();
+        fs_restore_mounts(mounts, mount_count);
+        return 0;
+    }
+    
+    fs_slot_count = info->slot_count;
+    fs_file_count = info->file_count;
+    fs_free_entry_head = info->free_entry_head;
+    fs_blocks_init(info->block_count);
+    if (keep_index) {
+        fs_hash_tombstones = info->hash_tombstones;
+        fs_hash_compact();
+    } else {
+        fs_hash_rebuild();
+    }
+    
+    fs_restore_mounts(mounts, mount_count);
+    return 1;
+}
@@ -0,0 +1,173 @@
+#include "initrd.h"
+#include "filesystem.h"
+#include "string.h"
+#include "types.h"
+
+static const uint8_t* initrd_base;
+static uint32_t initrd_size = 0;
+static int initrd_root_length;     // Of the mount path, to find paths inside the archive
+
+// Numbers are octal text, possibly space padded in front
+static uint32_t initrd_octal(const char* field, int length) {
+    uint32_t value = 0;
+    int i = 0;
+    
+    while (i < length && field[i] == ' ') {
+        i++;
+    }
+    for (; i < length && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+// The checksum is the byte sum of the header with its own field read as spaces
+static int initrd_valid_header(const tar_header_t* header) {
+    const uint8_t* bytes = (const uint8_t*)header;
+    uint32_t sum = ' ' * sizeof(header->checksum);
+    
+    if (header->name[0] == '\0' || strncmp(header->magic, TAR_MAGIC, 5) != 0) {
+        return 0;
+    }
+    for (int i = 0; i < TAR_BLOCK_SIZE; i++) {
+        sum += bytes[i];
+    }
+    for (int i = 0; i < (int)sizeof(header->checksum); i++) {
+        sum -= (uint8_t)header->checksum[i];
+    }
+    return sum == initrd_octal(header->checksum, sizeof(header->checksum));
+}
+
+// Turn "./DOCS/A.TXT" or a prefix/name pair into "DOCS\A.TXT"
+static void initrd_path(const tar_header_t* header, char* path) {
+    char joined[TAR_PATH_MAX];
+    int length = 0;
+    
+    for (int i = 0; i < (int)sizeof(header->prefix) && header->prefix[i]; i++) {
+        joined[length++] = header->prefix[i];
+    }
+    if (length > 0) {
+        joined[length++] = '/';
+    }
+    for (int i = 0; i < (int)sizeof(header->name) && header->name[i]; i++) {
+        joined[length++] = header->name[i];
+    }
+    joined[length] = '\0';
+    
+    const char* source = joined;
+    while (source[0] == '.' && source[1] == '/') {
+        source += 2;
+    }
+    
+    length = 0;
+    for (; *source; source++) {
+        path[length++] = *source == '/' ? '\\' : *source;
+    }
+    while (length > 0 && path[length - 1] == '\\') {
+        length--;
+    }
+    path[length] = '\0';
+}
+
+// Add the entries directly inside `dir`. Walking the headers is one pointer
+// hop per member, and only happens for directories somebody looks at.
+// Directories that only appear as part of longer paths are added too.
+static int initrd_load(fs_file_t* dir) {
+    const char* prefix = dir->name + initrd_root_length;
+    if (*prefix == '\\') {
+        prefix++;
+    }
+    int prefix_length = strlen(prefix);
+    char path[TAR_PATH_MAX];
+    
+    uint32_t offset = 0;
+    while (offset + TAR_BLOCK_SIZE <= initrd_size) {
+        const tar_header_t* header = (const tar_header_t*)(initrd_base + offset);
+        if (!initrd_valid_header(header)) {
+            break;
+        }
+        
+        uint32_t size = initrd_octal(header->size, sizeof(header->size));
+        uint32_t data = offset + TAR_BLOCK_SIZE;
+        uint32_t next = data + ((size + TAR_BLOCK_SIZE - 1) & ~(TAR_BLOCK_SIZE - 1));
+        if (next < data || next > initrd_size) {
+            break;
+        }
+        
+        initrd_path(header, path);
+        char* name = path;
+        if (prefix_length > 0) {
+            name = strncmp(path, prefix, prefix_length) == 0 && path[prefix_length] == '\\' ? path + prefix_length + 1 : NULL;
+        }
+        
+        if (name && *name) {
+            char* separator = strchr(name, '\\');
+            if (separator) {
+                *separator = '\0';
+                fs_add_loaded(dir, name, FS_DIRECTORY, 0, 0, offset);
+            } else if (header->type == TAR_TYPE_DIRECTORY) {
+                fs_add_loaded(dir, name, FS_DIRECTORY, 0, 0, offset);
+            } else if (header->type == TAR_TYPE_FILE || header->type == TAR_TYPE_FILE_OLD) {
+                fs_add_loaded(dir, name, FS_FILE, size, data, offset);
+            }
+        }
+        
+        offset = next;
+    }
+    return 1;
+}
+
+static unsigned int initrd_read(const fs_file_t* file, unsigned int offset, char* buffer, unsigned int length) {
+    if (offset >= file->size) {
+        return 0;
+    }
+    if (length > file->size - offset) {
+        length = file->size - offset;
+    }
+    memcpy(buffer, initrd_base + file->location + offset, length);
+    return length;
+}
+
+// Each file's data is one run inside the module
+static const char* initrd_map(const fs_file_t* file, unsigned int offset, unsigned int* length) {
+    *length = file->size - offset;
+    return (const char*)initrd_base + file->location + offset;
+}
+
+// No write hooks: the archive is read-only
+static const fs_volume_t initrd_volume = {
+    initrd_load,
+    initrd_read,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    initrd_map,
+};
+
+// Mount the first module tagged as the initrd. Only its first header is
+// looked at here, so boot time doesn't depend on the archive's size.
+int initrd_init(uint32_t magic, multiboot_info_t* mbi) {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !mbi || !(mbi->flags & MULTIBOOT_INFO_MODS)) {
+        return 0;
+    }
+    
+    multiboot_module_t* modules = (multiboot_module_t*)mbi->mods_addr;
+    for (uint32_t i = 0; i < mbi->mods_count; i++) {
+        multiboot_module_t* module = &modules[i];
+        if (!module->string || !strstr((const char*)module->string, INITRD_MODULE_TAG)) {
+            continue;
+        }
+        
+        uint32_t size = module->mod_end - module->mod_start;
+        if (size < TAR_BLOCK_SIZE || !initrd_valid_header((const tar_header_t*)module->mod_start)) {
+            return 0;
+        }
+        
+        initrd_base = (const uint8_t*)module->mod_start;
+        initrd_size = size;
+        initrd_root_length = strlen(INITRD_MOUNT_PATH);
+        return fs_mount(INITRD_MOUNT_PATH, &initrd_volume, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,232 @@
+#include "snapshot.h"
+#include "bcache.h"
+#include "blockdev.h"
+#include "fat.h"
+#include "filesystem.h"
+#include "string.h"
+#include "types.h"
+
+#define SNAPSHOT_ADLER_MOD 65521
+#define SNAPSHOT_ADLER_BLOCK 5552  // Bytes that can be summed before reducing
+
+// Payload stream state. Whole sectors go straight between the device and
+// the tables; only the odd pieces pass through the staging sector.
+static blockdev_t* snapshot_device;
+static uint8_t snapshot_sector[BLOCKDEV_SECTOR_SIZE];
+static uint32_t snapshot_lba;
+static unsigned int snapshot_offset;   // Bytes staged (save) or used up (load)
+static uint32_t snapshot_remaining;
+static uint32_t snapshot_checksum;
+static uint32_t snapshot_expected;     // Load: what the header says the checksum is
+static int snapshot_damaged;
+
+static uint32_t snapshot_adler(uint32_t adler, const uint8_t* data, uint32_t length) {
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    
+    while (length > 0) {
+        uint32_t chunk = length < SNAPSHOT_ADLER_BLOCK ? length : SNAPSHOT_ADLER_BLOCK;
+        length -= chunk;
+        while (chunk-- > 0) {
+            a += *data++;
+            b += a;
+        }
+        a %= SNAPSHOT_ADLER_MOD;
+        b %= SNAPSHOT_ADLER_MOD;
+    }
+    return (b << 16) | a;
+}
+
+static void snapshot_begin(uint32_t lba, uint32_t bytes, unsigned int offset) {
+    snapshot_lba = lba;
+    snapshot_offset = offset;
+    snapshot_remaining = bytes;
+    snapshot_checksum = 1;
+    snapshot_damaged = 0;
+}
+
+static int snapshot_write(void* data, unsigned int length) {
+    const uint8_t* bytes = data;
+    if (length > snapshot_remaining) {
+        return 0;
+    }
+    snapshot_remaining -= length;
+    snapshot_checksum = snapshot_adler(snapshot_checksum, bytes, length);
+    
+    while (length > 0) {
+        if (snapshot_offset == 0 && length >= BLOCKDEV_SECTOR_SIZE) {
+            unsigned int sectors = length / BLOCKDEV_SECTOR_SIZE;
+            if (!snapshot_device->write(snapshot_lba, sectors, bytes)) {
+                return 0;
+            }
+            snapshot_lba += sectors;
+            bytes += sectors * BLOCKDEV_SECTOR_SIZE;
+            length -= sectors * BLOCKDEV_SECTOR_SIZE;
+            continue;
+        }
+        
+        unsigned int chunk = BLOCKDEV_SECTOR_SIZE - snapshot_offset;
+        if (chunk > length) {
+            chunk = length;
+        }
+        memcpy(snapshot_sector + snapshot_offset, bytes, chunk);
+        snapshot_offset += chunk;
+        bytes += chunk;
+        length -= chunk;
+        
+        // The payload's last sector is padded out with zeroes
+        if (snapshot_offset < BLOCKDEV_SECTOR_SIZE && snapshot_remaining == 0) {
+            memset(snapshot_sector + snapshot_offset, 0, BLOCKDEV_SECTOR_SIZE - snapshot_offset);
+            snapshot_offset = BLOCKDEV_SECTOR_SIZE;
+        }
+        if (snapshot_offset == BLOCKDEV_SECTOR_SIZE) {
+            if (!snapshot_device->write(snapshot_lba++, 1, snapshot_sector)) {
+                return 0;
+            }
+            snapshot_offset = 0;
+        }
+    }
+    return 1;
+}
+
+// Fails once the whole payload is in and doesn't match its checksum
+static int snapshot_read(void* data, unsigned int length) {
+    uint8_t* bytes = data;
+    if (length > snapshot_remaining) {
+        return 0;
+    }
+    snapshot_remaining -= length;
+    
+    while (length > 0) {
+        if (bytes && snapshot_offset == BLOCKDEV_SECTOR_SIZE && length >= BLOCKDEV_SECTOR_SIZE) {
+            unsigned int sectors = length / BLOCKDEV_SECTOR_SIZE;
+            unsigned int chunk = sectors * BLOCKDEV_SECTOR_SIZE;
+            if (!snapshot_device->read(snapshot_lba, sectors, bytes)) {
+                return 0;
+            }
+            snapshot_checksum = snapshot_adler(snapshot_checksum, bytes, chunk);
+            snapshot_lba += sectors;
+            bytes += chunk;
+            length -= chunk;
+            continue;
+        }
+        
+        if (snapshot_offset == BLOCKDEV_SECTOR_SIZE) {
+            if (!snapshot_device->read(snapshot_lba++, 1, snapshot_sector)) {
+                return 0;
+            }
+            snapshot_offset = 0;
+        }
+        
+        unsigned int chunk = BLOCKDEV_SECTOR_SIZE - snapshot_offset;
+        if (chunk > length) {
+            chunk = length;
+        }
+        snapshot_checksum = snapshot_adler(snapshot_checksum, snapshot_sector + snapshot_offset, chunk);
+        if (bytes) {
+            memcpy(bytes, snapshot_sector + snapshot_offset, chunk);
+            bytes += chunk;
+        }
+        snapshot_offset += chunk;
+        length -= chunk;
+    }
+    
+    if (snapshot_remaining == 0 && snapshot_checksum != snapshot_expected) {
+        snapshot_damaged = 1;
+        return 0;
+    }
+    return 1;
+}
+
+static uint32_t snapshot_header_checksum(const snapshot_header_t* header) {
+    return snapshot_adler(1, (const uint8_t*)header, sizeof(*header) - sizeof(header->header_checksum));
+}
+
+// Everything goes straight to the device, so the cache must not hold
+// anything for the sectors involved
+static int snapshot_open_device(void) {
+    snapshot_device = bcache_get_device();
+    return snapshot_device && bcache_invalidate();
+}
+
+int snapshot_save(void) {
+    snapshot_header_t header;
+    
+    if (!snapshot_open_device()) {
+        return SNAPSHOT_NO_DISK;
+    }
+    if (!fs_snapshot_prepare(&header.info)) {
+        return SNAPSHOT_IO_ERROR;
+    }
+    
+    uint32_t bytes = fs_snapshot_size(&header.info);
+    uint32_t sectors = (bytes + BLOCKDEV_SECTOR_SIZE - 1) / BLOCKDEV_SECTOR_SIZE;
+    if (sectors + 1 > snapshot_device->sectors ||
+        snapshot_device->sectors - 1 - sectors < fat_volume_end()) {
+        return SNAPSHOT_NO_ROOM;
+    }
+    
+    uint32_t header_lba = snapshot_device->sectors - 1;
+    snapshot_begin(header_lba - sectors, bytes, 0);
+    if (!fs_snapshot_save(&header.info, snapshot_write) || snapshot_remaining != 0) {
+        return SNAPSHOT_IO_ERROR;
+    }
+    
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.header_size = sizeof(header);
+    header.entry_size = sizeof(fs_file_t);
+    header.block_size = FS_BLOCK_SIZE;
+    header.max_filename = FS_MAX_FILENAME;
+    header.payload_bytes = bytes;
+    header.payload_sectors = sectors;
+    header.payload_checksum = snapshot_checksum;
+    header.header_checksum = snapshot_header_checksum(&header);
+    
+    // The payload has to be on the disk before the header points at it
+    memset(snapshot_sector, 0, BLOCKDEV_SECTOR_SIZE);
+    memcpy(snapshot_sector, &header, sizeof(header));
+    if (!snapshot_device->flush() ||
+        !snapshot_device->write(header_lba, 1, snapshot_sector) ||
+        !snapshot_device->flush()) {
+        return SNAPSHOT_IO_ERROR;
+    }
+    return SNAPSHOT_OK;
+}
+
+int snapshot_load(void) {
+    snapshot_header_t header;
+    
+    if (!snapshot_open_device()) {
+        return SNAPSHOT_NO_DISK;
+    }
+    uint32_t header_lba = snapshot_device->sectors - 1;
+    if (!snapshot_device->read(header_lba, 1, snapshot_sector)) {
+        return SNAPSHOT_IO_ERROR;
+    }
+    memcpy(&header, snapshot_sector, sizeof(header));
+    
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        header.header_size != sizeof(header) || header.entry_size != sizeof(fs_file_t) ||
+        header.block_size != FS_BLOCK_SIZE || header.max_filename != FS_MAX_FILENAME ||
+        header.header_checksum != snapshot_header_checksum(&header) ||
+        header.payload_sectors >= header_lba ||
+        header.payload_bytes > header.payload_sectors * BLOCKDEV_SECTOR_SIZE) {
+        return SNAPSHOT_NOT_FOUND;
+    }
+    if (!fs_snapshot_fits(&header.info)) {
+        return SNAPSHOT_TOO_LARGE;
+    }
+    
+    // Every byte must be read for the checksum to be checked at all
+    if (fs_snapshot_size(&header.info) != header.payload_bytes) {
+        return SNAPSHOT_NOT_FOUND;
+    }
+    
+    snapshot_begin(header_lba - header.payload_sectors, header.payload_bytes, BLOCKDEV_SECTOR_SIZE);
+    snapshot_expected = header.payload_checksum;
+    if (!fs_snapshot_restore(&header.info, snapshot_read)) {
+        return snapshot_damaged ? SNAPSHOT_DAMAGED : SNAPSHOT_IO_ERROR;
+    }
+    return SNAPSHOT_OK;
+}
@@ -1,14 +1,104 @@
 #include "string.h"
 
+// Word-at-a-time helpers: a 32-bit word holds a zero byte exactly when
+// STRING_HAS_ZERO() is non-zero. Aligned word reads never cross a page,
+// so reading a little past the terminator is harmless.
+#define STRING_ONES 0x01010101u
+#define STRING_HIGHS 0x80808080u
+#define STRING_HAS_ZERO(word) (((word) - STRING_ONES) & ~(word) & STRING_HIGHS)
+#define STRING_ALIGNED(p) (((uintptr_t)(p) & 3) == 0)
+#define STRING_SAME_ALIGNMENT(a, b) ((((uintptr_t)(a) ^ (uintptr_t)(b)) & 3) == 0)
+
+// Below this size the setup cost of the SSE2 loops isn't worth it
+#define STRING_SSE2_THRESHOLD 64
+
+// SSE2 routines are compiled for SSE2 regardless of the kernel's flags and
+// only run once cpu_init() has enabled SSE and called string_set_sse2()
+#define STRING_SSE2 __attribute__((target("sse2")))
+
+typedef uint32_t __attribute__((may_alias)) string_word_t;
+typedef int string_vector_t __attribute__((vector_size(16)));
+
+static int string_sse2 = 0;
+
+void string_set_sse2(int enabled) {
+    string_sse2 = enabled;
+}
+
+int string_get_sse2(void) {
+    return string_sse2;
+}
+
+// Bit i set if byte i of the aligned 16-byte block is zero
+STRING_SSE2 static inline unsigned int string_zero_mask_sse2(const char* block) {
+    unsigned int mask;
+    __asm__ volatile(
+        "pxor %%xmm0, %%xmm0\n\t"
+        "movdqa (%1), %%xmm1\n\t"
+        "pcmpeqb %%xmm0, %%xmm1\n\t"
+        "pmovmskb %%xmm1, %0"
+        : "=r" (mask) : "r" (block) : "xmm0", "xmm1", "memory");
+    return mask;
+}
+
+STRING_SSE2 static int strlen_sse2(const char* str) {
+    const char* block = (const char*)((uintptr_t)str & ~(uintptr_t)15);
+    
+    // Ignore bytes of the first block that come before the string
+    unsigned int mask = string_zero_mask_sse2(block) & (0xFFFFu << ((uintptr_t)str & 15));
+    while (!mask) {
+        block += 16;
+        mask = string_zero_mask_sse2(block);
+    }
+    
+    return block + __builtin_ctz(mask) - str;
+}
+
 int strlen(const char* str) {
-    int len = 0;
-    while (str[len]) {
-        len++;
+    if (string_sse2) {
+        return strlen_sse2(str);
+    }
+    
+    const char* s = str;
+    while (!STRING_ALIGNED(s)) {
+        if (!*s) {
+            return s - str;
+        }
+        s++;
+    }
+    
+    const string_word_t* word = (const string_word_t*)s;
+    while (!STRING_HAS_ZERO(*word)) {
+        word++;
     }
-    return len;
+    
+    s = (const char*)word;
+    while (*s) {
+        s++;
+    }
+    return s - str;
 }
 
 int strcmp(const char* s1, const char* s2) {
+    if (STRING_SAME_ALIGNMENT(s1, s2)) {
+        while (!STRING_ALIGNED(s1) && *s1 && (*s1 == *s2)) {
+            s1++;
+            s2++;
+        }
+        
+        if (STRING_ALIGNED(s1)) {
+            const string_word_t* w1 = (const string_word_t*)s1;
+            const string_word_t* w2 = (const string_word_t*)s2;
+            while (*w1 == *w2 && !STRING_HAS_ZERO(*w1)) {
+                w1++;
+                w2++;
+            }
+            s1 = (const char*)w1;
+            s2 = (const char*)w2;
+        }
+    }
+    
+    // Finish inside the word that differs or ends the string
     while (*s1 && (*s1 == *s2)) {
         s1++;
         s2++;
@@ -17,18 +107,144 @@ int strcmp(const char* s1, const char* s2) {
 }
 
 void strcpy(char* dest, const char* src) {
+    if (STRING_SAME_ALIGNMENT(dest, src)) {
+        while (!STRING_ALIGNED(src)) {
+            if (!(*dest++ = *src++)) {
+                return;
+            }
+        }
+        
+        string_word_t* d = (string_word_t*)dest;
+        const string_word_t* s = (const string_word_t*)src;
+        while (!STRING_HAS_ZERO(*s)) {
+            *d++ = *s++;
+        }
+        dest = (char*)d;
+        src = (const char*)s;
+    }
+    
     while (*src) {
         *dest++ = *src++;
     }
     *dest = '\0';
 }
 
-char* strcat(char* dest, const char* src) {
-    char* dest_end = dest + strlen(dest);
-    while (*src) {
-        *dest_end++ = *src++;
+STRING_SSE2 static void memcpy_sse2(char* dest, const char* src, size_t n) {
+    // Load all four registers before storing so forward memmove stays safe
+    for (; n >= 64; n -= 64, dest += 64, src += 64) {
+        __asm__ volatile(
+            "movdqu 0(%1), %%xmm0\n\t"
+            "movdqu 16(%1), %%xmm1\n\t"
+            "movdqu 32(%1), %%xmm2\n\t"
+            "movdqu 48(%1), %%xmm3\n\t"
+            "movdqu %%xmm0, 0(%0)\n\t"
+            "movdqu %%xmm1, 16(%0)\n\t"
+            "movdqu %%xmm2, 32(%0)\n\t"
+            "movdqu %%xmm3, 48(%0)"
+            : : "r" (dest), "r" (src) : "xmm0", "xmm1", "xmm2", "xmm3", "memory");
+    }
+    
+    size_t words = n / 4;
+    size_t bytes = n % 4;
+    __asm__ volatile("rep movsl" : "+D" (dest), "+S" (src), "+c" (words) : : "memory");
+    __asm__ volatile("rep movsb" : "+D" (dest), "+S" (src), "+c" (bytes) : : "memory");
+}
+
+void* memcpy(void* dest, const void* src, size_t n) {
+    void* d = dest;
+    
+    if (string_sse2 && n >= STRING_SSE2_THRESHOLD) {
+        memcpy_sse2(dest, src, n);
+        return dest;
+    }
+    
+    size_t words = n / 4;
+    size_t bytes = n % 4;
+    __asm__ volatile("rep movsl" : "+D" (d), "+S" (src), "+c" (words) : : "memory");
+    __asm__ volatile("rep movsb" : "+D" (d), "+S" (src), "+c" (bytes) : : "memory");
+    return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    char* d = dest;
+    const char* s = src;
+    
+    // Copying forward is safe unless dest overlaps the end of src
+    if (d <= s || d >= s + n) {
+        return memcpy(dest, src, n);
+    }
+    
+    // Copy backward: the odd tail bytes first, then whole words
+    size_t words = n / 4;
+    size_t bytes = n % 4;
+    char* d_tail = d + n - 1;
+    const char* s_tail = s + n - 1;
+    __asm__ volatile("std\n\trep movsb\n\tcld" : "+D" (d_tail), "+S" (s_tail), "+c" (bytes) : : "memory");
+    
+    if (words) {
+        char* d_word = d + words * 4 - 4;
+        const char* s_word = s + words * 4 - 4;
+        __asm__ volatile("std\n\trep movsl\n\tcld" : "+D" (d_word), "+S" (s_word), "+c" (words) : : "memory");
     }
-    *dest_end = '\0';
+    return dest;
+}
+
+STRING_SSE2 static void memset_sse2(char* dest, uint32_t pattern, size_t n) {
+    string_vector_t fill;
+    __asm__("movd %1, %0\n\tpshufd $0, %0, %0" : "=x" (fill) : "r" (pattern));
+    
+    for (; n >= 64; n -= 64, dest += 64) {
+        __asm__ volatile(
+            "movdqu %1, 0(%0)\n\t"
+            "movdqu %1, 16(%0)\n\t"
+            "movdqu %1, 32(%0)\n\t"
+            "movdqu %1, 48(%0)"
+            : : "r" (dest), "x" (fill) : "memory");
+    }
+    
+    size_t words = n / 4;
+    size_t bytes = n % 4;
+    __asm__ volatile("rep stosl" : "+D" (dest), "+c" (words) : "a" (pattern) : "memory");
+    __asm__ volatile("rep stosb" : "+D" (dest), "+c" (bytes) : "a" (pattern) : "memory");
+}
+
+void* memset(void* dest, int value, size_t n) {
+    void* d = dest;
+    uint32_t pattern = (unsigned char)value * STRING_ONES;
+    
+    if (string_sse2 && n >= STRING_SSE2_THRESHOLD) {
+        memset_sse2(dest, pattern, n);
+        return dest;
+    }
+    
+    size_t words = n / 4;
+    size_t bytes = n % 4;
+    __asm__ volatile("rep stosl" : "+D" (d), "+c" (words) : "a" (pattern) : "memory");
+    __asm__ volatile("rep stosb" : "+D" (d), "+c" (bytes) : "a" (pattern) : "memory");
+    return dest;
+}
+
+// Fill `count` 16-bit cells, e.g. VGA character/attribute pairs
+void* memsetw(void* dest, uint16_t value, size_t count) {
+    uint32_t pattern = value | ((uint32_t)value << 16);
+    uint16_t* d = dest;
+    
+    if (string_sse2 && count * 2 >= STRING_SSE2_THRESHOLD) {
+        memset_sse2((char*)d, pattern, (count & ~(size_t)1) * 2);
+    } else {
+        size_t words = count / 2;
+        uint16_t* p = d;
+        __asm__ volatile("rep stosl" : "+D" (p), "+c" (words) : "a" (pattern) : "memory");
+    }
+    
+    if (count & 1) {
+        d[count - 1] = value;
+    }
+    return dest;
+}
+
+char* strcat(char* dest, const char* src) {
+    strcpy(dest + strlen(dest), src);
     return dest;
 }
 
@@ -88,7 +304,61 @@ void itoa(int value, char* str, int base) {
     }
 }
 
+// 64-bit by 32-bit division without relying on libgcc's __udivdi3
+uint64_t udiv64(uint64_t dividend, uint32_t divisor, uint32_t* remainder) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t low = (uint32_t)dividend;
+    uint32_t quotient_high = high / divisor;
+    uint32_t quotient_low;
+    uint32_t rem = high % divisor;
+    
+    // rem < divisor, so the second divide cannot overflow
+    __asm__("divl %4" : "=a" (quotient_low), "=d" (rem) : "a" (low), "d" (rem), "rm" (divisor));
+    
+    if (remainder) {
+        *remainder = rem;
+    }
+    
+    return ((uint64_t)quotient_high << 32) | quotient_low;
+}
+
+void u64toa(uint64_t value, char* str) {
+    char digits[21];
+    int count = 0;
+    
+    do {
+        uint32_t digit;
+        value = udiv64(value, 10, &digit);
+        digits[count++] = '0' + digit;
+    } while (value);
+    
+    while (count > 0) {
+        *str++ = digits[--count];
+    }
+    *str = '\0';
+}
+
 int strncmp(const char* s1, const char* s2, size_t n) {
+    if (STRING_SAME_ALIGNMENT(s1, s2)) {
+        while (n && !STRING_ALIGNED(s1) && *s1 && (*s1 == *s2)) {
+            ++s1;
+            ++s2;
+            --n;
+        }
+        
+        if (STRING_ALIGNED(s1)) {
+            const string_word_t* w1 = (const string_word_t*)s1;
+            const string_word_t* w2 = (const string_word_t*)s2;
+            while (n >= 4 && *w1 == *w2 && !STRING_HAS_ZERO(*w1)) {
+                w1++;
+                w2++;
+                n -= 4;
+            }
+            s1 = (const char*)w1;
+            s2 = (const char*)w2;
+        }
+    }
+    
     while (n && *s1 && (*s1 == *s2)) {
         ++s1;
         ++s2;
@@ -117,6 +387,22 @@ char* strchr(const char* s, int c) {
     return NULL;
 }
 
+char* strstr(const char* haystack, const char* needle) {
+    int length = strlen(needle);
+    if (length == 0) {
+        return (char*)haystack;
+    }
+    
+    // Only try positions that start with the right character
+    for (; (haystack = strchr(haystack, needle[0])) != NULL; haystack++) {
+        if (strncmp(haystack, needle, length) == 0) {
+            return (char*)haystack;
+        }
+    }
+    
+    return NULL;
+}
+
 size_t strspn(const char* str, const char* accept) {
     const char* s = str;
     
@@ -189,15 +475,29 @@ void strtok(char* str, const char* delim, char** saveptr, char** token) {
 
 char* strrchr(const char* s, int c) {
     const char* last = NULL;
+    char ch = (char)c;
+    uint32_t pattern = (unsigned char)ch * STRING_ONES;
     
-    while (*s != '\0') {
-        if (*s == c) {
+    while (1) {
+        // Skip whole words that hold neither the character nor the terminator
+        if (STRING_ALIGNED(s)) {
+            const string_word_t* word = (const string_word_t*)s;
+            while (!STRING_HAS_ZERO(*word) && !STRING_HAS_ZERO(*word ^ pattern)) {
+                word++;
+            }
+            s = (const char*)word;
+        }
+        
+        if (*s == ch) {
             last = s;
         }
+        if (*s == '\0') {
+            break;
+        }
         s++;
     }
     
-    if (c == '\0') {
+    if (ch == '\0') {
         return (char*)s;
     }
     